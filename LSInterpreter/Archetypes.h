@@ -2,197 +2,521 @@
 #ifndef ARCHETYPES_H
 #define ARCHETYPES_H
 
+#include <algorithm>
 #include <functional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <variant>
 #include "Grammar.h"
+#include "Stats.h"
 
 using std::vector; using std::string;
 
-using Data = std::variant<bool, int, double, string>;
+//Out of line storage of a string value. Copies of a var share it, the last one frees it
+struct StringData {
+    explicit StringData(const string& value) : refs(1), value(value) {
+        LS_STAT(GetStats().stringAllocations++);
+    }
+
+    explicit StringData(string&& value) : refs(1), value(std::move(value)) {
+        LS_STAT(GetStats().stringAllocations++);
+    }
 
+    int refs; string value;
+};
+
+//A value tagged with its type. Bools and numbers are stored inline and strings are reference counted,
+//so a var is 16 bytes and copying one never copies a string
 class Var {
 public:
-    Var() : data_(0), type_(ERROR) {}
-    Var(const string& data) : data_(data), type_(STRING) {}
-    Var(const double& data) : data_(data), type_(DOUBLE) {}
-    Var(const int& data) : data_(data), type_(INT) {}
-    Var(const bool& data) : data_(data), type_(BOOL) {}
+    Var() : type_(ERROR) { value_.i = 0; }
+    Var(const string& data) : type_(STRING) { value_.s = new StringData(data); }
+    Var(const double& data) : type_(DOUBLE) { value_.d = data; }
+    Var(const int& data) : type_(INT) { value_.i = data; }
+    Var(const bool& data) : type_(BOOL) { value_.b = data; }
+
+    Var(const Var& other) : value_(other.value_), type_(other.type_) {
+        Retain();
+    }
+
+    Var(Var&& other) noexcept : value_(other.value_), type_(other.type_) {
+        other.type_ = ERROR; other.value_.i = 0;
+    }
+
+    Var& operator=(const Var& other) {
+        other.Retain(); Drop();
+        value_ = other.value_; type_ = other.type_;
+        return *this;
+    }
+
+    Var& operator=(Var&& other) noexcept {
+        if (this != &other) {
+            Drop();
+            value_ = other.value_; type_ = other.type_;
+            other.type_ = ERROR; other.value_.i = 0;
+        }
+        return *this;
+    }
+
+    ~Var() {
+        Drop();
+    }
 
-    Data GetData() const {
-        return data_;
+    //Returns: A var that is not defined. Memory slots hold these before 'var' and after 'delete'
+    static Var Undefined() {
+        Var var; var.type_ = UNDEFINED;
+        return var;
     }
 
+    //Typed getters for callers that already checked the type
+    bool GetBool() const {
+        return value_.b;
+    }
+
+    int GetInt() const {
+        return value_.i;
+    }
+
+    double GetDouble() const {
+        return value_.d;
+    }
+
+    const string& GetString() const {
+        return value_.s->value;
+    }
+
+    //Reuses the string storage if no other var shares it
     void SetData(const string& data) {
-        data_ = data; type_ = STRING;
+        if (type_ == STRING && value_.s->refs == 1) {
+            value_.s->value = data;
+            return;
+        }
+        Drop();
+        value_.s = new StringData(data); type_ = STRING;
+    }
+
+    void SetData(const std::string_view data) {
+        if (type_ == STRING && value_.s->refs == 1) {
+            value_.s->value.assign(data);
+            return;
+        }
+        Drop();
+        value_.s = new StringData(string(data)); type_ = STRING;
+    }
+
+    //Appends to the string in place if no other var shares it, so building a string piece by piece grows it
+    //geometrically instead of copying it on every piece. Text taken from the string itself is copied first
+    void Append(const std::string_view data) {
+        if (value_.s->refs == 1) {
+            string& value = value_.s->value;
+            if (data.data() >= value.data() && data.data() < value.data() + value.size())
+                value.append(string(data));
+            else
+                value.append(data);
+            return;
+        }
+        string joined; joined.reserve(value_.s->value.size() + data.size());
+        joined.append(value_.s->value).append(data);
+        Drop();
+        value_.s = new StringData(std::move(joined));
     }
 
     void SetData(const double& data) {
-        data_ = data; type_ = DOUBLE;
+        Drop();
+        value_.d = data; type_ = DOUBLE;
     }
 
     void SetData(const int& data) {
-        data_ = data; type_ = INT;
+        Drop();
+        value_.i = data; type_ = INT;
     }
 
     void SetData(const bool& data) {
-        data_ = data; type_ = BOOL;
+        Drop();
+        value_.b = data; type_ = BOOL;
     }
 
     int GetType() const {
         return type_;
     }
 
+    bool IsDefined() const {
+        return type_ != UNDEFINED;
+    }
+
+    //Frees the slot, dropping any string it holds
+    void Release() {
+        Drop();
+        value_.i = 0; type_ = UNDEFINED;
+    }
+
+    //Vars are equal if both their types and values are. An int never equals a double
+    bool operator==(const Var& other) const {
+        if (type_ != other.type_)
+            return false;
+
+        switch (type_) {
+            case STRING: return value_.s == other.value_.s || GetString() == other.GetString();
+            case DOUBLE: return value_.d == other.value_.d;
+            case BOOL: return value_.b == other.value_.b;
+            default: return value_.i == other.value_.i;
+        }
+    }
+
+    bool operator!=(const Var& other) const {
+        return !(*this == other);
+    }
+
 private:
-    int type_; Data data_;
+    void Retain() const {
+        if (type_ == STRING)
+            value_.s->refs++;
+    }
+
+    void Drop() {
+        if (type_ == STRING && --value_.s->refs == 0)
+            delete value_.s;
+    }
+
+    union Value {
+        bool b; int i; double d; StringData* s;
+    };
+
+    Value value_; int type_;
 };
 
+static_assert(sizeof(Var) == 16, "Var should stay 16 bytes");
+
 using Arguments = vector<string>;
-using Implementation = std::function<void(const Arguments&)>;
 
-//An instruction consists of arguments with specific types and an implementation
-class Instruction {
+//An operand is a pre-decoded argument. Its index points into the table matching its kind
+class Operand {
 public:
-    Instruction() : types_(vector<int>{}), implementation_() {}
-
-    Instruction(const vector<int>& types, const Implementation& imp)
-        : types_(types), implementation_(imp) {}
+    Operand() : kind_(OPERAND_NONE), index_(0) {}
+    Operand(const int& kind, const int& index) : kind_(kind), index_(index) {}
 
     //Getters
+    int GetKind() const {
+        return kind_;
+    }
 
-    vector<int> GetTypes() const {
-        return types_;
+    int GetIndex() const {
+        return index_;
     }
 
-    Implementation GetImplementation() const {
-        return implementation_;
+    //Setters
+    void SetIndex(const int& index) {
+        index_ = index;
+    }
+
+private:
+    int kind_; int index_;
+};
+
+//Fixed capacity operand list, so compiled instructions never own heap memory
+class Operands {
+public:
+    static const int MAX_OPERANDS = 4;
+
+    Operands() : size_(0) {}
+
+    //The index is taken by value, since GCC reuses the stack slots of literal temporaries across the dispatch handlers
+    const Operand& operator[](int index) const {
+        return operands_[index];
+    }
+
+    Operand& operator[](int index) {
+        return operands_[index];
     }
 
-    //Function to execute the implementation
-    void Execute(const Arguments& args) const {
-        implementation_(args);
+    int Size() const {
+        return size_;
+    }
+
+    void Push(const Operand& operand) {
+        if (size_ == MAX_OPERANDS)
+            throw std::runtime_error("Instruction received too many arguments");
+        operands_[size_++] = operand;
     }
 
 private:
-    vector<int> types_;
-    Implementation implementation_;
+    Operand operands_[MAX_OPERANDS]; int size_;
 };
 
+//The implementation of an opcode. The overloads that compile to each opcode are listed by instructionSignatures
+using Implementation = std::function<void(const Operands&)>;
+
+//A compiled line: the real line number, the opcode of the resolved overload and its decoded operands
 class InstructionHandle {
 public:
-    InstructionHandle() = default;
+    InstructionHandle() : line_(-1), opcode_(OP_LABEL), operands_() {}
 
-    InstructionHandle(int line, const Arguments& args, const Implementation& implementation)
-        : line_(line), args_(args), implementation_(implementation) {}
+    InstructionHandle(const int& line, const int& opcode, const Operands& operands)
+        : line_(line), opcode_(opcode), operands_(operands) {}
 
     // Getters
     int GetLine() const {
         return line_;
     }
 
-    void Execute() {
-        implementation_(args_);
+    int GetOpcode() const {
+        return opcode_;
+    }
+
+    const Operands& GetOperands() const {
+        return operands_;
     }
 
     // Setters
-    void SetLine(int line) {
+    void SetLine(const int& line) {
         line_ = line;
     }
 
-    void SetArgs(const Arguments& args) {
-        args_ = args;
+    void SetOpcode(const int& opcode) {
+        opcode_ = opcode;
+    }
+
+    void SetOperands(const Operands& operands) {
+        operands_ = operands;
     }
 
 private:
-    int line_;
-    Arguments args_;
-    Implementation implementation_;
+    int line_; int opcode_;
+    Operands operands_;
 };
 
-class ControlStructure {
+//A function's range of instructions and the layout of its frame. Parameters take the first slots, in order
+class FunctionScope {
 public:
-    ControlStructure() : types_(vector<int>{}), implementation_() {}
-
-    ControlStructure(const vector<int>& types, const std::function<void(const vector<string>&, const int&)>& imp)
-        : types_(types), implementation_(imp) {}
+    FunctionScope(const string& name, const vector<string>& params, const int& begin)
+        : name_(name), begin_(begin), end_(begin), locals_(params), paramCount_((int)params.size()) {}
 
     //Getters
-    vector<int> GetTypes() const {
-        return types_;
+    const string& GetName() const {
+        return name_;
+    }
+
+    int GetBegin() const {
+        return begin_;
+    }
+
+    int GetEnd() const {
+        return end_;
+    }
+
+    int GetParamCount() const {
+        return paramCount_;
+    }
+
+    int GetFrameSize() const {
+        return (int)locals_.size();
     }
 
-    //Function to execute the implementation
-    void Execute(const vector<string>& args, const int& lineNum) const {
-        implementation_(args, lineNum);
+    const string& GetLocalName(const int& slot) const {
+        return locals_[slot];
+    }
+
+    //Returns: Frame slot of a local, or -1 if the name is not local to the function
+    int FindLocal(const string& name) const {
+        for (int i = 0; i < (int)locals_.size(); i++)
+            if (locals_[i] == name)
+                return i;
+        return -1;
+    }
+
+    //Setters
+    void SetRange(const int& begin, const int& end) {
+        begin_ = begin; end_ = end;
+    }
+
+    //Adds a local to the frame. Returns: its slot
+    int AddLocal(const string& name) {
+        const int found = FindLocal(name);
+        if (found != -1)
+            return found;
+        locals_.push_back(name);
+        return (int)locals_.size() - 1;
     }
 
 private:
-    vector<int> types_;
-    std::function<void(const vector<string>&, const int&)> implementation_;
+    string name_; int begin_, end_;
+    vector<string> locals_; int paramCount_;
 };
 
-class ControlStructureData {
+//The compiled program: instructions plus the tables their operands index into
+class Program {
 public:
-    ControlStructureData() = default;
+    Program() = default;
 
-    ControlStructureData(const int& line, const int & type, const string& endStatement) :
-        line_(line), type_(type), endStatement_(endStatement), jumpBegin_("") {}
+    //Getters
+    vector<InstructionHandle>& GetCode() {
+        return code_;
+    }
 
-    ControlStructureData(const int& line, const int& type, const string& jumpBegin, const string& jumpEnd, const string& endStatement) :
-        line_(line), type_(type), jumpBegin_(jumpBegin), jumpEnd_(jumpEnd), endStatement_(endStatement) {}
+    const Var& GetConstant(const int& index) const {
+        return constants_[index];
+    }
 
-    //Getters
-    int GetLine() const {
-        return line_;
+    const string& GetIdentifier(const int& index) const {
+        return identifiers_[index];
     }
 
-    int GetType() const {
-        return type_;
+    const std::unordered_map<string, int>& GetLabels() const {
+        return labels_;
     }
 
-    string GetEndStatement() {
-        return endStatement_;
+    //Returns: Instruction index of a label, or -1 if it is undefined
+    int FindLabel(const string& name) const {
+        auto found = labels_.find(name);
+        return found == labels_.cend() ? -1 : found->second;
     }
 
-    string GetJumpBegin() const {
-        return jumpBegin_;
+    //Returns: Source form of an operand of an instruction in a function (-1 for none). Only used for diagnostics
+    string OperandToString(const Operand& operand, const int& function) const {
+        switch (operand.GetKind()) {
+            case OPERAND_CONSTANT: {
+                const Var& constant = constants_[operand.GetIndex()];
+                switch (constant.GetType()) {
+                    case STRING: return "\"" + constant.GetString() + "\"";
+                    case DOUBLE: return std::to_string(constant.GetDouble());
+                    case INT: return std::to_string(constant.GetInt());
+                    case BOOL: return constant.GetBool() ? "true" : "false";
+                    default: return string();
+                }
+            }
+            case OPERAND_VARIABLE: return identifiers_[operand.GetIndex()];
+            case OPERAND_LOCAL: return function == -1 ? "@" + std::to_string(operand.GetIndex()) : functions_[function].GetLocalName(operand.GetIndex());
+            case OPERAND_LABEL: return GetLabelName(operand.GetIndex());
+            case OPERAND_OPERATOR: return IntToOperator(operand.GetIndex());
+            case OPERAND_FUNCTION: return operand.GetIndex() == -1 ? "-" : functions_[operand.GetIndex()].GetName();
+            default: return string();
+        }
     }
 
-    string GetJumpEnd() const {
-        return jumpEnd_;
+    //Returns: Name of the label at an instruction index, preferring the name of a function that starts there.
+    //Only used for diagnostics, but the name must not depend on the order the labels were added in
+    string GetLabelName(const int& target) const {
+        const int function = FindFunction(target);
+        if (function != -1)
+            return functions_[function].GetName();
+
+        const string* found = nullptr;
+        for (const auto& [name, index] : labels_)
+            if (index == target && (found == nullptr || name < *found))
+                found = &name;
+        return found == nullptr ? "@" + std::to_string(target) : *found;
     }
 
-    //Setters
-    void SetEndStatement(const string& endStatement) {
-        endStatement_ = endStatement;
+    int GetIdentifierCount() const {
+        return (int)identifiers_.size();
+    }
+
+    int GetConstantCount() const {
+        return (int)constants_.size();
+    }
+
+    vector<FunctionScope>& GetFunctions() {
+        return functions_;
+    }
+
+    const FunctionScope& GetFunction(const int& index) const {
+        return functions_[index];
+    }
+
+    //Returns: Index of the function whose label is at an instruction index, or -1
+    int FindFunction(const int& labelIndex) const {
+        for (int i = 0; i < (int)functions_.size(); i++)
+            if (functions_[i].GetBegin() == labelIndex)
+                return i;
+        return -1;
+    }
+
+    //Returns: Size of the largest frame
+    int GetMaxFrameSize() const {
+        int size = 0;
+        for (const auto& function : functions_)
+            size = std::max(size, function.GetFrameSize());
+        return size;
+    }
+
+    //Adds a literal to the constant pool. Returns: its index
+    int AddConstant(const Var& constant) {
+        constants_.push_back(constant);
+        return (int)constants_.size() - 1;
+    }
+
+    //Interns an identifier. Returns: the index shared by every use of the name
+    int AddIdentifier(const string& name) {
+        return Intern(identifierIndex_, identifiers_, name);
+    }
+
+    //Registers a label at an instruction index. The first definition of a name wins
+    void AddLabel(const string& name, const int& target) {
+        labels_.emplace(name, target);
+    }
+
+    //Registers a function starting at the instruction index of its label. Returns: its index
+    int AddFunction(const string& name, const vector<string>& params, const int& begin) {
+        functions_.push_back(FunctionScope(name, params, begin));
+        return (int)functions_.size() - 1;
+    }
+
+    //Moves every label and function range to a new instruction index, after instructions were removed.
+    //newIndex maps a removed instruction to the last instruction kept before it, so a range starts at the first instruction kept after that
+    void RemapLabels(const vector<int>& newIndex) {
+        auto FirstKept = [&newIndex](const int& index) {
+            return index == 0 ? 0 : newIndex[index - 1] + 1;
+        };
+
+        for (auto& [name, index] : labels_)
+            index = newIndex[index];
+        for (auto& function : functions_)
+            function.SetRange(FirstKept(function.GetBegin()), FirstKept(function.GetEnd()));
     }
 
 private:
-    int line_; int type_; string jumpBegin_, jumpEnd_, endStatement_;
+    static int Intern(std::unordered_map<string, int>& index, vector<string>& names, const string& name) {
+        auto found = index.find(name);
+        if (found != index.cend())
+            return found->second;
+
+        names.push_back(name);
+        index.emplace(name, (int)names.size() - 1);
+        return (int)names.size() - 1;
+    }
+
+    vector<InstructionHandle> code_;
+    vector<Var> constants_; vector<string> identifiers_;
+    std::unordered_map<string, int> identifierIndex_, labels_;
+    vector<FunctionScope> functions_;
 };
 
-class Function {
+//The state of the caller saved by a call: where to return to and the frame to restore
+class Frame {
 public:
-    Function() : name_(""), args_() {}
-    Function(const string& name, const vector<string>& args) : name_(name), args_(args) {}
+    Frame(const int& returnIndex, const int& base, const int& top, const int& function)
+        : returnIndex_(returnIndex), base_(base), top_(top), function_(function) {}
 
     //Getters
-    string GetName() const {
-        return name_;
+    int GetReturnIndex() const {
+        return returnIndex_;
     }
 
-    vector<string> GetArgs() const {
-        return args_;
+    int GetBase() const {
+        return base_;
     }
 
-    //Setters
-    void AddArg(const string& arg) {
-        args_.push_back(arg);
+    int GetTop() const {
+        return top_;
+    }
+
+    int GetFunction() const {
+        return function_;
     }
 
 private:
-    string name_; vector<string> args_;
+    int returnIndex_, base_, top_, function_;
 };
 #endif // !ARCHETYPES_H
 
@@ -0,0 +1,278 @@
+#pragma once
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "Archetypes.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LS_CACHE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <process.h>
+#else
+#include <chrono>
+#endif
+
+using std::vector; using std::string;
+
+// Compiled programs are cached next to their script, in a .lsc file. A cache is used when it was written for the same source
+// by a build with the same compiler version and opcodes, otherwise the script is compiled as usual and the cache written again.
+// Layout: the header, the instructions as they are laid out in memory, then the constants, identifiers, labels and functions.
+
+static_assert(std::is_trivially_copyable_v<InstructionHandle>, "Instructions are cached as raw bytes");
+
+//Version of the cache layout and of what the front end compiles a script to. The opcodes are hashed, but a change to parsing,
+//lowering or the optimizer can compile the same source differently with the same opcodes. Bump it with any such change
+const uint32_t CACHE_VERSION = 2;
+
+//Returns: 64 bit FNV-1a hash of a range of bytes, continuing from hash
+uint64_t HashBytes(const char* data, const size_t& size, uint64_t hash = 14695981039346656037ull) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+//Returns: Hash of the compiler version, the opcodes and the instruction layout of this build. Caches written by other builds are ignored
+uint64_t HashBuild() {
+    const uint32_t layout[] = { CACHE_VERSION, (uint32_t)OPCODE_COUNT, (uint32_t)sizeof(InstructionHandle), (uint32_t)sizeof(Operand) };
+    uint64_t hash = HashBytes(reinterpret_cast<const char*>(layout), sizeof(layout));
+    for (int opcode = 0; opcode < OPCODE_COUNT; opcode++) {
+        const string name = IntToOpcode(opcode);
+        hash = HashBytes(name.data(), name.size() + 1, hash);
+    }
+    return hash;
+}
+
+struct CacheHeader {
+    char magic[4]; uint32_t version;
+    uint64_t sourceHash, buildHash;
+    uint32_t instructionCount;
+};
+
+//Appends values to the bytes of a cache
+class CacheWriter {
+public:
+    template<typename T>
+    void Write(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "Only plain values are written as bytes");
+        WriteBytes(&value, sizeof(T));
+    }
+
+    void WriteString(const string& s) {
+        Write((uint32_t)s.size()); WriteBytes(s.data(), s.size());
+    }
+
+    void WriteBytes(const void* data, const size_t& size) {
+        bytes_.append(static_cast<const char*>(data), size);
+    }
+
+    const string& GetBytes() const {
+        return bytes_;
+    }
+
+private:
+    string bytes_;
+};
+
+//Reads values back from the bytes of a cache. Reading past the end throws, so a truncated cache is never used
+class CacheReader {
+public:
+    CacheReader(const char* data, const size_t& size) : data_(data), size_(size), position_(0) {}
+
+    template<typename T>
+    T Read() {
+        T value;
+        std::memcpy(&value, ReadBytes(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    string ReadString() {
+        const uint32_t size = Read<uint32_t>();
+        return string(ReadBytes(size), size);
+    }
+
+    const char* ReadBytes(const size_t& size) {
+        if (size > size_ - position_)
+            throw std::runtime_error("Truncated cache");
+        const char* bytes = data_ + position_;
+        position_ += size;
+        return bytes;
+    }
+
+private:
+    const char* data_; size_t size_, position_;
+};
+
+//Returns: A temporary path next to a cache, unique to this process, so runs of the same script at once never write the same file
+string TemporaryPath(const string& path) {
+#if defined(LS_CACHE_MMAP)
+    const long long id = (long long)getpid();
+#elif defined(_WIN32)
+    const long long id = (long long)_getpid();
+#else
+    const long long id = (long long)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    return path + "." + std::to_string(id) + ".tmp";
+}
+
+//Writes the compiled program to a cache. The cache is written to a temporary file first, so no run ever reads half of one.
+//Returns: Whether the cache was written
+bool SaveProgram(Program& program, const string& path, const uint64_t& sourceHash) {
+    const vector<InstructionHandle>& code = program.GetCode();
+    CacheWriter writer;
+
+    CacheHeader header = { { 'L', 'S', 'C', '\0' }, CACHE_VERSION, sourceHash, HashBuild(), (uint32_t)code.size() };
+    writer.Write(header);
+    writer.WriteBytes(code.data(), code.size() * sizeof(InstructionHandle));
+
+    writer.Write((uint32_t)program.GetConstantCount());
+    for (int i = 0; i < program.GetConstantCount(); i++) {
+        const Var& constant = program.GetConstant(i);
+        writer.Write((int32_t)constant.GetType());
+        switch (constant.GetType()) {
+            case STRING: writer.WriteString(constant.GetString()); break;
+            case DOUBLE: writer.Write(constant.GetDouble()); break;
+            case INT: writer.Write((int32_t)constant.GetInt()); break;
+            case BOOL: writer.Write((uint8_t)constant.GetBool()); break;
+            default: break;
+        }
+    }
+
+    writer.Write((uint32_t)program.GetIdentifierCount());
+    for (int i = 0; i < program.GetIdentifierCount(); i++)
+        writer.WriteString(program.GetIdentifier(i));
+
+    writer.Write((uint32_t)program.GetLabels().size());
+    for (const auto& [name, target] : program.GetLabels()) {
+        writer.WriteString(name); writer.Write((int32_t)target);
+    }
+
+    writer.Write((uint32_t)program.GetFunctions().size());
+    for (const FunctionScope& function : program.GetFunctions()) {
+        writer.WriteString(function.GetName());
+        writer.Write((int32_t)function.GetBegin()); writer.Write((int32_t)function.GetEnd());
+        writer.Write((int32_t)function.GetParamCount()); writer.Write((int32_t)function.GetFrameSize());
+        for (int slot = 0; slot < function.GetFrameSize(); slot++)
+            writer.WriteString(function.GetLocalName(slot));
+    }
+
+    const string temporary = TemporaryPath(path);
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return false;
+        file.write(writer.GetBytes().data(), (std::streamsize)writer.GetBytes().size());
+        if (!file.good()) {
+            file.close(); std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+//Reads a cached program into an empty program. The instructions are copied straight out of the cache in one go
+//Returns: Whether the cache was fresh and read. The program is left empty otherwise
+bool ReadProgram(Program& program, const char* data, const size_t& size, const uint64_t& sourceHash) {
+    try {
+        CacheReader reader(data, size);
+        const CacheHeader header = reader.Read<CacheHeader>();
+        if (std::memcmp(header.magic, "LSC", 4) != 0 || header.version != CACHE_VERSION || header.sourceHash != sourceHash || header.buildHash != HashBuild())
+            return false;
+
+        vector<InstructionHandle>& code = program.GetCode();
+        const char* instructions = reader.ReadBytes((size_t)header.instructionCount * sizeof(InstructionHandle));
+        code.resize(header.instructionCount);
+        std::memcpy(static_cast<void*>(code.data()), instructions, (size_t)header.instructionCount * sizeof(InstructionHandle));
+
+        const uint32_t constantCount = reader.Read<uint32_t>();
+        for (uint32_t i = 0; i < constantCount; i++) {
+            switch (reader.Read<int32_t>()) {
+                case STRING: program.AddConstant(Var(reader.ReadString())); break;
+                case DOUBLE: program.AddConstant(Var(reader.Read<double>())); break;
+                case INT: program.AddConstant(Var((int)reader.Read<int32_t>())); break;
+                case BOOL: program.AddConstant(Var(reader.Read<uint8_t>() != 0)); break;
+                default: program.AddConstant(Var()); break;
+            }
+        }
+
+        const uint32_t identifierCount = reader.Read<uint32_t>();
+        for (uint32_t i = 0; i < identifierCount; i++)
+            program.AddIdentifier(reader.ReadString());
+
+        const uint32_t labelCount = reader.Read<uint32_t>();
+        for (uint32_t i = 0; i < labelCount; i++) {
+            const string name = reader.ReadString();
+            program.AddLabel(name, reader.Read<int32_t>());
+        }
+
+        const uint32_t functionCount = reader.Read<uint32_t>();
+        for (uint32_t i = 0; i < functionCount; i++) {
+            const string name = reader.ReadString();
+            const int begin = reader.Read<int32_t>(), end = reader.Read<int32_t>();
+            const int paramCount = reader.Read<int32_t>(), frameSize = reader.Read<int32_t>();
+
+            vector<string> locals;
+            for (int slot = 0; slot < frameSize; slot++)
+                locals.push_back(reader.ReadString());
+
+            program.AddFunction(name, vector<string>(locals.begin(), locals.begin() + std::min(paramCount, frameSize)), begin);
+            FunctionScope& function = program.GetFunctions().back();
+            function.SetRange(begin, end);
+            for (int slot = paramCount; slot < frameSize; slot++)
+                function.AddLocal(locals[slot]);
+        }
+        return true;
+    }
+    catch (const std::runtime_error&) {
+        program = Program();
+        return false;
+    }
+}
+
+//Loads the cached program of a script, mapping the cache into memory where the platform allows it.
+//Returns: Whether the cache was fresh and loaded
+bool LoadProgram(Program& program, const string& path, const uint64_t& sourceHash) {
+#ifdef LS_CACHE_MMAP
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file == -1)
+        return false;
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size < (off_t)sizeof(CacheHeader)) {
+        close(file);
+        return false;
+    }
+
+    void* data = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (data == MAP_FAILED)
+        return false;
+
+    const bool loaded = ReadProgram(program, static_cast<const char*>(data), (size_t)status.st_size, sourceHash);
+    munmap(data, (size_t)status.st_size);
+    return loaded;
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    const string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return ReadProgram(program, data.data(), data.size(), sourceHash);
+#endif
+}
+
+#endif // !CACHE_H
@@ -1,10 +1,17 @@
 #pragma once
 #include <unordered_map>
 #include <string>
+#include <string_view>
+#include <functional>
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
 #ifndef GRAMMAR_H
 #define GRAMMAR_H
 
 enum DataTypes {
+    UNDEFINED = -1,
     ERROR = 0,
     STRING = 1000,
     DOUBLE = 2000,
@@ -12,7 +19,7 @@ enum DataTypes {
     BOOL = 4000
 };
 
-const enum ControlStatements {
+enum ControlStatements {
     IF = 0,
     ELSE,
     FOR,
@@ -24,7 +31,7 @@ const enum ControlStatements {
     END
 };
 
-const enum TokenType {
+enum TokenType {
     ARG = 0,
     COLON = 100,
     SEMICOLON = 200,
@@ -58,7 +65,181 @@ const enum TokenType {
 // 1300. Logical comparators like '==' and '>=' (LOGIC)
 using TokenTypes = std::vector<int>;
 
-const std::unordered_map<std::string, int> separators = {
+// Operators carried by LOGIC and MOD tokens, decoded once when an instruction is compiled
+enum Operators {
+    EQUAL = 0,
+    NOT_EQUAL,
+    LESS,
+    GREATER,
+    LESS_EQUAL,
+    GREATER_EQUAL,
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    MODULO,
+    INCREMENT,
+    DECREMENT,
+    NO_OPERATOR
+};
+
+// Opcodes of the compiled instructions. Every instruction overload has exactly one opcode.
+// The opcodes after OP_HALT are specialized forms of OP_IF_COMPARE, OP_MODIFY and OP_STEP for fixed operand types,
+// chosen at load time, followed by superinstructions that replace the first instruction of a fused sequence.
+// Last come unchecked forms of the specialized opcodes and loop superinstructions, in the same order, for operands whose types
+// were proven at load time. Keep each group contiguous, GetGenericOpcode relies on it.
+// They are listed through a macro, so the dispatch engine can build its jump table in the same order.
+#define LS_OPCODES(X) \
+    X(OP_LABEL) \
+    X(OP_PRINT) \
+    X(OP_PRINTL) \
+    X(OP_ENDL) \
+    X(OP_CLS) \
+    X(OP_FLUSH) \
+    X(OP_INPUT) \
+    X(OP_INPUT_PROMPT) \
+    X(OP_READ) \
+    X(OP_PUSH) \
+    X(OP_POP) \
+    X(OP_POP_CLEAR) \
+    X(OP_VAR) \
+    X(OP_VAR_DECLARE) \
+    X(OP_EXIT) \
+    X(OP_SET) \
+    X(OP_MODIFY) \
+    X(OP_STEP) \
+    X(OP_APPEND) \
+    X(OP_SQRT) \
+    X(OP_ABS) \
+    X(OP_RAND) \
+    X(OP_MILLIS) \
+    X(OP_SECONDS) \
+    X(OP_DELAY) \
+    X(OP_DELETE) \
+    X(OP_JUMP) \
+    X(OP_CALL) \
+    X(OP_ARG) \
+    X(OP_ARG_POP) \
+    X(OP_RETURN) \
+    X(OP_RETURN_VALUE) \
+    X(OP_IF_COMPARE) \
+    X(OP_IF_TRUE) \
+    X(OP_IF_FALSE) \
+    X(OP_HALT) \
+    X(OP_IF_EQ_INT_INT) \
+    X(OP_IF_NE_INT_INT) \
+    X(OP_IF_LT_INT_INT) \
+    X(OP_IF_GT_INT_INT) \
+    X(OP_IF_LE_INT_INT) \
+    X(OP_IF_GE_INT_INT) \
+    X(OP_IF_EQ_DBL_DBL) \
+    X(OP_IF_NE_DBL_DBL) \
+    X(OP_IF_LT_DBL_DBL) \
+    X(OP_IF_GT_DBL_DBL) \
+    X(OP_IF_LE_DBL_DBL) \
+    X(OP_IF_GE_DBL_DBL) \
+    X(OP_IF_LT_INT_DBL) \
+    X(OP_IF_GT_INT_DBL) \
+    X(OP_IF_LE_INT_DBL) \
+    X(OP_IF_GE_INT_DBL) \
+    X(OP_IF_LT_DBL_INT) \
+    X(OP_IF_GT_DBL_INT) \
+    X(OP_IF_LE_DBL_INT) \
+    X(OP_IF_GE_DBL_INT) \
+    X(OP_ADD_INT_INT) \
+    X(OP_SUB_INT_INT) \
+    X(OP_MUL_INT_INT) \
+    X(OP_DIV_INT_INT) \
+    X(OP_MOD_INT_INT) \
+    X(OP_ADD_DBL_DBL) \
+    X(OP_SUB_DBL_DBL) \
+    X(OP_MUL_DBL_DBL) \
+    X(OP_DIV_DBL_DBL) \
+    X(OP_ADD_DBL_INT) \
+    X(OP_SUB_DBL_INT) \
+    X(OP_MUL_DBL_INT) \
+    X(OP_DIV_DBL_INT) \
+    X(OP_INC_INT) \
+    X(OP_DEC_INT) \
+    X(OP_INC_DBL) \
+    X(OP_DEC_DBL) \
+    X(OP_INC_INT_LOOP_LT) \
+    X(OP_INC_INT_LOOP_LE) \
+    X(OP_SET_MOD_IF_ZERO) \
+    X(OP_IF_EQ_INT_INT_UNCHECKED) \
+    X(OP_IF_NE_INT_INT_UNCHECKED) \
+    X(OP_IF_LT_INT_INT_UNCHECKED) \
+    X(OP_IF_GT_INT_INT_UNCHECKED) \
+    X(OP_IF_LE_INT_INT_UNCHECKED) \
+    X(OP_IF_GE_INT_INT_UNCHECKED) \
+    X(OP_IF_EQ_DBL_DBL_UNCHECKED) \
+    X(OP_IF_NE_DBL_DBL_UNCHECKED) \
+    X(OP_IF_LT_DBL_DBL_UNCHECKED) \
+    X(OP_IF_GT_DBL_DBL_UNCHECKED) \
+    X(OP_IF_LE_DBL_DBL_UNCHECKED) \
+    X(OP_IF_GE_DBL_DBL_UNCHECKED) \
+    X(OP_IF_LT_INT_DBL_UNCHECKED) \
+    X(OP_IF_GT_INT_DBL_UNCHECKED) \
+    X(OP_IF_LE_INT_DBL_UNCHECKED) \
+    X(OP_IF_GE_INT_DBL_UNCHECKED) \
+    X(OP_IF_LT_DBL_INT_UNCHECKED) \
+    X(OP_IF_GT_DBL_INT_UNCHECKED) \
+    X(OP_IF_LE_DBL_INT_UNCHECKED) \
+    X(OP_IF_GE_DBL_INT_UNCHECKED) \
+    X(OP_ADD_INT_INT_UNCHECKED) \
+    X(OP_SUB_INT_INT_UNCHECKED) \
+    X(OP_MUL_INT_INT_UNCHECKED) \
+    X(OP_DIV_INT_INT_UNCHECKED) \
+    X(OP_MOD_INT_INT_UNCHECKED) \
+    X(OP_ADD_DBL_DBL_UNCHECKED) \
+    X(OP_SUB_DBL_DBL_UNCHECKED) \
+    X(OP_MUL_DBL_DBL_UNCHECKED) \
+    X(OP_DIV_DBL_DBL_UNCHECKED) \
+    X(OP_ADD_DBL_INT_UNCHECKED) \
+    X(OP_SUB_DBL_INT_UNCHECKED) \
+    X(OP_MUL_DBL_INT_UNCHECKED) \
+    X(OP_DIV_DBL_INT_UNCHECKED) \
+    X(OP_INC_INT_UNCHECKED) \
+    X(OP_DEC_INT_UNCHECKED) \
+    X(OP_INC_DBL_UNCHECKED) \
+    X(OP_DEC_DBL_UNCHECKED) \
+    X(OP_INC_INT_LOOP_LT_UNCHECKED) \
+    X(OP_INC_INT_LOOP_LE_UNCHECKED)
+
+#define LS_OPCODE_ENUM(name) name,
+enum Opcodes {
+    LS_OPCODES(LS_OPCODE_ENUM)
+    OPCODE_COUNT
+};
+#undef LS_OPCODE_ENUM
+
+// Kinds of pre-decoded operands. The index of an operand is a constant pool index, a memory slot,
+// the instruction index a label resolved to, or an Operators value respectively.
+enum OperandKinds {
+    OPERAND_NONE = 0,
+    OPERAND_CONSTANT,
+    OPERAND_VARIABLE,
+    OPERAND_LABEL,
+    OPERAND_OPERATOR,
+    // Slot in the frame of the function the instruction is in
+    OPERAND_LOCAL,
+    // Index of the function a call enters, -1 for labels that are not functions
+    OPERAND_FUNCTION
+};
+
+// Hashes strings and string_views alike, so maps keyed by names can be searched with a view into the source
+struct NameHash {
+    using is_transparent = void;
+    size_t operator()(const std::string_view name) const {
+        return std::hash<std::string_view>{}(name);
+    }
+};
+
+template<typename T>
+using NameMap = std::unordered_map<std::string, T, NameHash, std::equal_to<>>;
+
+//Every separator and its TokenType. Separators are one or two characters long
+constexpr std::pair<std::string_view, int> separators[] = {
     {":", COLON}, {";", SEMICOLON}, {",", COMMA}, {"!", NEG},
     {"=", SET}, {"++", MOD}, {"--", MOD}, {"+=", MOD},
     {"-=", MOD}, {"*=", MOD}, {"/=", MOD}, {"%=", MOD},
@@ -67,10 +248,66 @@ const std::unordered_map<std::string, int> separators = {
     {"{", O_CURLY}, {"}", C_CURLY}, {">>", RSHIFT}, {"<<", LSHIFT}
 };
 
+//Characters separators are made of. Each of them has a class of its own, every other character is class 0.
+//The class after theirs stands for the end of a token
+constexpr std::string_view SEPARATOR_CHARS = ":;,!=+-*/%<>(){}";
+constexpr int SEPARATOR_CLASS_COUNT = (int)SEPARATOR_CHARS.size() + 2, SEPARATOR_END = SEPARATOR_CLASS_COUNT - 1;
+
+//Classifies separators with two lookups: the class of each character, then the TokenType of the pair of classes
+struct SeparatorTable {
+    std::array<uint8_t, 256> classes;
+    //TokenType of every pair of classes, ARG where they form no separator
+    std::array<std::array<int, SEPARATOR_CLASS_COUNT>, SEPARATOR_CLASS_COUNT> types;
+};
+
+constexpr SeparatorTable BuildSeparatorTable() {
+    SeparatorTable table{};
+    table.classes.fill(0);
+    for (size_t i = 0; i < SEPARATOR_CHARS.size(); i++)
+        table.classes[(unsigned char)SEPARATOR_CHARS[i]] = (uint8_t)(i + 1);
+
+    for (auto& row : table.types)
+        row.fill(ARG);
+    for (const auto& [text, type] : separators)
+        table.types[table.classes[(unsigned char)text[0]]][text.size() == 2 ? table.classes[(unsigned char)text[1]] : SEPARATOR_END] = type;
+    return table;
+}
+
+constexpr SeparatorTable separatorTable = BuildSeparatorTable();
+
+//Returns: TokenType of the two character separator first and second form, or ARG if they form none
+constexpr int ClassifySeparator(const char& first, const char& second) {
+    return separatorTable.types[separatorTable.classes[(unsigned char)first]][separatorTable.classes[(unsigned char)second]];
+}
+
+//Returns: TokenType of the one character separator c, or ARG if it is none
+constexpr int ClassifySeparator(const char& c) {
+    return separatorTable.types[separatorTable.classes[(unsigned char)c]][SEPARATOR_END];
+}
+
+//Returns: TokenType of a separator, or ARG if the token is not one
+constexpr int ClassifyToken(const std::string_view token) {
+    switch (token.size()) {
+        case 1: return ClassifySeparator(token[0]);
+        case 2: return ClassifySeparator(token[0], token[1]);
+        default: return ARG;
+    }
+}
+
+//Returns: Whether every separator is classified as its TokenType, and nothing else is a separator
+constexpr bool ClassifiesEverySeparator() {
+    for (const auto& [text, type] : separators)
+        if (ClassifyToken(text) != type)
+            return false;
+    return ClassifyToken("+") == ARG && ClassifyToken("=<") == ARG && ClassifyToken("a=") == ARG && ClassifyToken("===") == ARG;
+}
+static_assert(ClassifiesEverySeparator(), "Separators are classified through separatorTable");
 
 // Helper functions for conversions and such
 std::string IntToType(const int& type) {
     switch (type) {
+        case -1:
+            return "undefined";
         case 0:
             return "ErrorType";
         case 1000:
@@ -124,6 +361,222 @@ int GetDataType(const std::string& line) {
     return ERROR;
 }
 
+int GetOperator(const std::string& op) {
+    if (op == "==") return EQUAL;
+    if (op == "!=") return NOT_EQUAL;
+    if (op == "<") return LESS;
+    if (op == ">") return GREATER;
+    if (op == "<=") return LESS_EQUAL;
+    if (op == ">=") return GREATER_EQUAL;
+    if (op == "+=") return ADD;
+    if (op == "-=") return SUBTRACT;
+    if (op == "*=") return MULTIPLY;
+    if (op == "/=") return DIVIDE;
+    if (op == "%=") return MODULO;
+    if (op == "++") return INCREMENT;
+    if (op == "--") return DECREMENT;
+    return NO_OPERATOR;
+}
+
+std::string IntToOperator(const int& op) {
+    switch (op) {
+    case EQUAL:
+        return "==";
+    case NOT_EQUAL:
+        return "!=";
+    case LESS:
+        return "<";
+    case GREATER:
+        return ">";
+    case LESS_EQUAL:
+        return "<=";
+    case GREATER_EQUAL:
+        return ">=";
+    case ADD:
+        return "+=";
+    case SUBTRACT:
+        return "-=";
+    case MULTIPLY:
+        return "*=";
+    case DIVIDE:
+        return "/=";
+    case MODULO:
+        return "%=";
+    case INCREMENT:
+        return "++";
+    case DECREMENT:
+        return "--";
+    default:
+        return "???";
+    }
+}
+
+//Returns: Name of an opcode without its 'OP_' prefix. The names are listed by LS_OPCODES, like the opcodes themselves
+std::string IntToOpcode(const int& opcode) {
+#define LS_OPCODE_NAME(name) #name,
+    static const char* const names[OPCODE_COUNT] = { LS_OPCODES(LS_OPCODE_NAME) };
+#undef LS_OPCODE_NAME
+    if (opcode < 0 || opcode >= OPCODE_COUNT)
+        return "???";
+    return names[opcode] + 3;
+}
+
+//Returns: Whether the operand at index names a jump target rather than a value
+bool IsLabelOperand(const int& opcode, const int& index, const int& count) {
+    switch (opcode) {
+    case OP_JUMP:
+    case OP_CALL:
+    case OP_IF_COMPARE:
+    case OP_IF_TRUE:
+    case OP_IF_FALSE:
+        return index == count - 1;
+    default:
+        return false;
+    }
+}
+
+// Signatures of the instruction overloads. An overload is resolved by the name of the instruction and the TokenTypes of its
+// arguments, which are packed into one integer. The built-in overloads are listed in a constexpr table, and found through
+// perfect hash tables which are built while compiling the interpreter.
+
+//Signature of TokenTypes that no overload has, as there are more of them than fit
+constexpr uint64_t NO_SIGNATURE = ~0ull;
+
+//Returns: The signature of TokenTypes, 4 bits per type. As every type is encoded as 1 or more, signatures of different length never match
+constexpr uint64_t EncodeSignature(const int* types, const size_t& count) {
+    if (count > 15)
+        return NO_SIGNATURE;
+    uint64_t signature = 0;
+    for (size_t i = 0; i < count; i++)
+        signature = signature << 4 | (uint64_t)(types[i] / 100 + 1);
+    return signature;
+}
+
+constexpr uint64_t EncodeSignature(const std::initializer_list<int> types) {
+    return EncodeSignature(types.begin(), types.size());
+}
+
+uint64_t EncodeSignature(const TokenTypes& types) {
+    return EncodeSignature(types.data(), types.size());
+}
+
+struct InstructionSignature {
+    std::string_view name; uint64_t signature; int opcode;
+};
+
+//Every overload of the built-in instructions. Overloads of the same instruction are listed next to each other
+constexpr InstructionSignature instructionSignatures[] = {
+    { "print", EncodeSignature({ COLON, ARG }), OP_PRINT },
+    { "printl", EncodeSignature({ COLON, ARG }), OP_PRINTL },
+    { "endl", EncodeSignature({}), OP_ENDL },
+    { "cls", EncodeSignature({}), OP_CLS },
+    { "flush", EncodeSignature({}), OP_FLUSH },
+    { "input", EncodeSignature({ COLON, ARG }), OP_INPUT },
+    { "input", EncodeSignature({ COLON, ARG, COMMA, ARG }), OP_INPUT_PROMPT },
+    { "read", EncodeSignature({ COLON, ARG }), OP_READ },
+    { "push", EncodeSignature({ COLON, ARG }), OP_PUSH },
+    { "pop", EncodeSignature({ COLON, ARG }), OP_POP },
+    { "pop", EncodeSignature({}), OP_POP_CLEAR },
+    { "var", EncodeSignature({ ARG, SET, ARG }), OP_VAR },
+    { "var", EncodeSignature({ ARG }), OP_VAR_DECLARE },
+    { "exit", EncodeSignature({ COLON, ARG }), OP_EXIT },
+    //Statements named by an identifier rather than an instruction, which is prepended as an argument
+    { "[VarName]", EncodeSignature({ ARG, SET, ARG }), OP_SET },
+    { "[VarName]", EncodeSignature({ ARG, MOD, ARG }), OP_MODIFY },
+    { "[VarName]", EncodeSignature({ ARG, MOD }), OP_STEP },
+    { "append", EncodeSignature({ COLON, ARG, COMMA, ARG }), OP_APPEND },
+    { "sqrt", EncodeSignature({ COLON, ARG }), OP_SQRT },
+    { "abs", EncodeSignature({ COLON, ARG }), OP_ABS },
+    { "rand", EncodeSignature({ COLON, ARG }), OP_RAND },
+    { "millis", EncodeSignature({ COLON, ARG }), OP_MILLIS },
+    { "seconds", EncodeSignature({ COLON, ARG }), OP_SECONDS },
+    { "delay", EncodeSignature({ COLON, ARG }), OP_DELAY },
+    { "delete", EncodeSignature({ COLON, ARG }), OP_DELETE },
+    { "jump", EncodeSignature({ COLON, ARG }), OP_JUMP },
+    { "call", EncodeSignature({ COLON, ARG }), OP_CALL },
+    { "arg", EncodeSignature({ COLON, ARG }), OP_ARG },
+    { "arg", EncodeSignature({}), OP_ARG_POP },
+    { "return", EncodeSignature({}), OP_RETURN },
+    { "return", EncodeSignature({ COLON, ARG }), OP_RETURN_VALUE },
+    { "if", EncodeSignature({ COLON, ARG, LOGIC, ARG, COMMA, ARG }), OP_IF_COMPARE },
+    { "if", EncodeSignature({ COLON, ARG, COMMA, ARG }), OP_IF_TRUE },
+    { "if", EncodeSignature({ COLON, NEG, ARG, COMMA, ARG }), OP_IF_FALSE }
+};
+constexpr int INSTRUCTION_OVERLOAD_COUNT = (int)(sizeof(instructionSignatures) / sizeof(instructionSignatures[0]));
+
+//Size of the perfect hash tables. A power of two, several times the number of overloads so a seed is found quickly
+constexpr size_t INSTRUCTION_TABLE_SIZE = 256;
+
+constexpr uint64_t HashInstruction(const std::string_view name, const uint64_t& signature, const uint64_t& seed) {
+    uint64_t hash = 14695981039346656037ull ^ seed;
+    for (const char& c : name) {
+        hash ^= (unsigned char)c;
+        hash *= 1099511628211ull;
+    }
+    for (int shift = 0; shift < 64; shift += 8) {
+        hash ^= signature >> shift & 0xFF;
+        hash *= 1099511628211ull;
+    }
+    return hash ^ hash >> 32;
+}
+
+//A perfect hash table of overloads: under its seed, no two of them hash to the same slot
+struct InstructionTable {
+    uint64_t seed;
+    //Index in instructionSignatures of the overload in each slot, or -1
+    std::array<int, INSTRUCTION_TABLE_SIZE> slots;
+
+    constexpr int Find(const std::string_view name, const uint64_t& signature) const {
+        return slots[HashInstruction(name, signature, seed) & (INSTRUCTION_TABLE_SIZE - 1)];
+    }
+};
+
+//Returns: A perfect hash table of the overloads, found by trying seeds. ByName: key on the name only, holding the first overload
+//of every instruction. Otherwise key on the name and the signature, holding every overload
+constexpr InstructionTable BuildInstructionTable(const bool& byName) {
+    for (uint64_t seed = 0; ; seed++) {
+        InstructionTable table{ seed, {} };
+        table.slots.fill(-1);
+
+        bool isPerfect = true;
+        for (int i = 0; i < INSTRUCTION_OVERLOAD_COUNT && isPerfect; i++) {
+            const InstructionSignature& overload = instructionSignatures[i];
+            if (byName && i > 0 && instructionSignatures[i - 1].name == overload.name)
+                continue;
+            int& slot = table.slots[HashInstruction(overload.name, byName ? 0 : overload.signature, seed) & (INSTRUCTION_TABLE_SIZE - 1)];
+            isPerfect = slot == -1;
+            slot = i;
+        }
+        if (isPerfect)
+            return table;
+    }
+}
+
+constexpr InstructionTable instructionNames = BuildInstructionTable(true), instructionOverloads = BuildInstructionTable(false);
+
+//Returns: Whether name is a built-in instruction
+constexpr bool IsInstructionName(const std::string_view name) {
+    const int index = instructionNames.Find(name, 0);
+    return index != -1 && instructionSignatures[index].name == name;
+}
+
+//Returns: Opcode of the overload of an instruction with a signature, or -1 if there is none
+constexpr int FindOpcode(const std::string_view name, const uint64_t& signature) {
+    const int index = instructionOverloads.Find(name, signature);
+    if (index == -1 || instructionSignatures[index].name != name || instructionSignatures[index].signature != signature)
+        return -1;
+    return instructionSignatures[index].opcode;
+}
+
+//Returns: Whether every overload is found through the tables, which fails if two overloads share a name and a signature
+constexpr bool FindsEveryOverload() {
+    for (const InstructionSignature& overload : instructionSignatures)
+        if (!IsInstructionName(overload.name) || FindOpcode(overload.name, overload.signature) != overload.opcode)
+            return false;
+    return !IsInstructionName("IF") && FindOpcode("if", EncodeSignature({ COLON, ARG })) == -1;
+}
+static_assert(FindsEveryOverload(), "Every overload of an instruction needs a signature of its own");
+
 std::string IntToTokenType(const int& type) {
     switch (type) {
     case ARG:
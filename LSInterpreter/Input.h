@@ -0,0 +1,202 @@
+#pragma once
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Archetypes.h"
+#include "Output.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <io.h>
+#endif
+
+using std::vector; using std::string;
+
+// Input of the programs the interpreter runs. Stdin is read in large blocks, which input splits into lines and read into fields,
+// so reading many values takes a read per block rather than per value. Both share the same buffer, so they can be mixed.
+// Like cin is tied to cout, the output is flushed before waiting for more input.
+
+//The errorLevel after reading
+enum InputResults {
+    //A value was read
+    INPUT_READ,
+    //The value read is of another type than the var
+    INPUT_MISMATCH,
+    //There is nothing left to read
+    INPUT_END
+};
+
+class Input {
+public:
+    static constexpr size_t BLOCK_SIZE = 1 << 16;
+
+    explicit Input(FILE* file = stdin) : buffer_(BLOCK_SIZE), begin_(0), end_(0), file_(file) {}
+
+    //Returns: Whether a line was read, without its line break
+    bool ReadLine(string& line) {
+        line.clear();
+        if (begin_ == end_ && !Fill())
+            return false;
+
+        while (true) {
+            const char* first = buffer_.data() + begin_;
+            const char* newline = (const char*)std::memchr(first, '\n', end_ - begin_);
+            if (newline != nullptr) {
+                line.append(first, newline);
+                begin_ = newline - buffer_.data() + 1;
+                return true;
+            }
+
+            //The last line may not end with a line break
+            line.append(first, end_ - begin_);
+            begin_ = end_;
+            if (!Fill())
+                return true;
+        }
+    }
+
+    //Returns: Whether a field was read. Fields are separated by whitespace and stay valid until the next read
+    bool ReadField(std::string_view& field) {
+        do {
+            while (begin_ < end_ && IsSpace(buffer_[begin_]))
+                begin_++;
+        } while (begin_ == end_ && Fill());
+        if (begin_ == end_)
+            return false;
+
+        size_t end = begin_;
+        while (true) {
+            while (end < end_ && !IsSpace(buffer_[end]))
+                end++;
+            if (end < end_)
+                break;
+
+            //The field goes on in the next block, which is read after it
+            const size_t length = end - begin_;
+            if (!Fill())
+                break;
+            end = begin_ + length;
+        }
+
+        field = std::string_view(buffer_.data() + begin_, end - begin_);
+        begin_ = end;
+        return true;
+    }
+
+    //Reads the next field into a var. Ints and doubles are parsed straight from the buffer, other fields are strings as they are.
+    //An uninitialized var gets the type of the field. Returns: The errorLevel, the var is left as it is unless a value was read
+    int Read(Var& var1) {
+        std::string_view field;
+        if (!ReadField(field))
+            return INPUT_END;
+
+        const char* first = field.data(); const char* last = first + field.size();
+        switch (var1.GetType()) {
+            case INT: {
+                int value = 0;
+                if (!Parses(std::from_chars(first, last, value), last))
+                    return INPUT_MISMATCH;
+                var1.SetData(value);
+                return INPUT_READ;
+            }
+            case DOUBLE: {
+                double value = 0.0;
+                if (!Parses(std::from_chars(first, last, value), last))
+                    return INPUT_MISMATCH;
+                var1.SetData(value);
+                return INPUT_READ;
+            }
+            case BOOL: {
+                if (field != "true" && field != "false")
+                    return INPUT_MISMATCH;
+                var1.SetData(field == "true");
+                return INPUT_READ;
+            }
+            case STRING: {
+                var1.SetData(field);
+                return INPUT_READ;
+            }
+            default:
+                break;
+        }
+
+        //Numbers are told apart from words by how they start, so inf and nan stay strings
+        int intValue = 0; double doubleValue = 0.0;
+        const bool number = std::isdigit((unsigned char)field.front()) || field.front() == '-' || field.front() == '.';
+        if (number && Parses(std::from_chars(first, last, intValue), last))
+            var1.SetData(intValue);
+        else if (number && Parses(std::from_chars(first, last, doubleValue), last))
+            var1.SetData(doubleValue);
+        else if (field == "true" || field == "false")
+            var1.SetData(field == "true");
+        else
+            var1.SetData(field);
+        return INPUT_READ;
+    }
+
+private:
+    static bool IsSpace(const char& c) {
+        return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    //Returns: Whether a number was parsed from the whole field
+    static bool Parses(const std::from_chars_result& result, const char* last) {
+        return result.ec == std::errc() && result.ptr == last;
+    }
+
+    //Reads the next block after what is left of the buffer. It grows when a single field fills all of it.
+    //Returns: Whether anything was read
+    bool Fill() {
+        if (begin_ != 0) {
+            std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+            end_ -= begin_; begin_ = 0;
+        }
+        if (end_ == buffer_.size())
+            buffer_.resize(buffer_.size() * 2);
+
+        if (file_ == stdin)
+            StandardOutput().Flush();
+
+        const size_t count = ReadBlock(buffer_.data() + end_, buffer_.size() - end_);
+        end_ += count;
+        LS_STAT(GetStats().inputBytes += count; GetStats().inputReads++);
+        return count != 0;
+    }
+
+    //Reads what is available, up to size bytes. Unlike fread, this returns as soon as a terminal has a line
+    size_t ReadBlock(char* data, const size_t& size) {
+#if defined(__unix__) || defined(__APPLE__)
+        ssize_t count;
+        do {
+            count = read(fileno(file_), data, size);
+        } while (count < 0 && errno == EINTR);
+        return count > 0 ? (size_t)count : 0;
+#elif defined(_WIN32)
+        const int count = _read(_fileno(file_), data, (unsigned int)std::min<size_t>(size, 1 << 30));
+        return count > 0 ? (size_t)count : 0;
+#else
+        return std::fread(data, 1, size, file_);
+#endif
+    }
+
+    vector<char> buffer_; size_t begin_, end_;
+    FILE* file_;
+};
+
+//Returns: The input every input and read instruction goes through
+Input& StandardInput() {
+    static Input input;
+    return input;
+}
+
+#endif // !INPUT_H
@@ -0,0 +1,479 @@
+#pragma once
+#ifndef JIT_H
+#define JIT_H
+
+// Tracing JIT of the dispatch engine. Loops that turn hot are recorded while they run, and the recorded path through the
+// loop is compiled to x86-64 machine code. A compiled trace runs the loop on the memory slots until a guard fails,
+// then returns the instruction the interpreter continues at.
+
+#if defined(__x86_64__) && defined(__linux__)
+#define LS_JIT_SUPPORTED
+#endif
+
+#ifdef LS_JIT_SUPPORTED
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Archetypes.h"
+#include "Optimize.h"
+
+using std::vector;
+
+// The machine code reads the value and the type of a var straight from memory: the value comes first, the type 8 bytes in
+static_assert(std::is_standard_layout_v<Var> && sizeof(Var) == 16, "The JIT relies on the layout of Var");
+constexpr int VAR_TYPE_OFFSET = 8;
+
+//Emits x86-64 machine code into a byte buffer. Only covers the instructions traces use, all of them on 32 bit values
+class Assembler {
+public:
+    enum Registers { EAX = 0, ECX = 1, EDX = 2, RSI = 6, RDI = 7 };
+    //Second byte of the two byte conditional jumps. A condition xor 1 is its negation
+    enum Conditions { JE = 0x84, JNE = 0x85, JL = 0x8C, JGE = 0x8D, JLE = 0x8E, JG = 0x8F };
+
+    //mov reg, [base + offset]
+    void Load(const int& reg, const int& base, const int& offset) {
+        Byte(0x8B); Memory(reg, base, offset);
+    }
+
+    //mov [base + offset], reg
+    void Store(const int& base, const int& offset, const int& reg) {
+        Byte(0x89); Memory(reg, base, offset);
+    }
+
+    //mov reg, value
+    void LoadImmediate(const int& reg, const int& value) {
+        Byte(0xB8 + reg); Int(value);
+    }
+
+    //cmp dword [base + offset], value. The 7 in the reg field selects cmp
+    void CompareMemory(const int& base, const int& offset, const int& value) {
+        Byte(0x81); Memory(7, base, offset); Int(value);
+    }
+
+    //cmp reg1, reg2
+    void Compare(const int& reg1, const int& reg2) {
+        Byte(0x39); Direct(reg2, reg1);
+    }
+
+    //cmp reg, value
+    void CompareImmediate(const int& reg, const int8_t& value) {
+        Byte(0x83); Direct(7, reg); Byte(value);
+    }
+
+    //test reg, reg
+    void Test(const int& reg) {
+        Byte(0x85); Direct(reg, reg);
+    }
+
+    //mov reg1, reg2
+    void Move(const int& reg1, const int& reg2) {
+        Byte(0x89); Direct(reg2, reg1);
+    }
+
+    //add reg1, reg2
+    void Add(const int& reg1, const int& reg2) {
+        Byte(0x01); Direct(reg2, reg1);
+    }
+
+    //add reg, value
+    void AddImmediate(const int& reg, const int8_t& value) {
+        Byte(0x83); Direct(0, reg); Byte(value);
+    }
+
+    //sub reg1, reg2
+    void Subtract(const int& reg1, const int& reg2) {
+        Byte(0x29); Direct(reg2, reg1);
+    }
+
+    //imul reg1, reg2
+    void Multiply(const int& reg1, const int& reg2) {
+        Byte(0x0F); Byte(0xAF); Direct(reg1, reg2);
+    }
+
+    //cdq; idiv reg. Leaves the quotient of eax / reg in eax and the remainder in edx
+    void Divide(const int& reg) {
+        Byte(0x99); Byte(0xF7); Direct(7, reg);
+    }
+
+    //Returns: Position of the displacement of a jump, to be patched once its target is known
+    int JumpIf(const int& condition) {
+        Byte(0x0F); Byte(condition); Int(0);
+        return Size() - 4;
+    }
+
+    int Jump() {
+        Byte(0xE9); Int(0);
+        return Size() - 4;
+    }
+
+    void Return() {
+        Byte(0xC3);
+    }
+
+    //Points the jump whose displacement is at 'at' to 'target'
+    void Patch(const int& at, const int& target) {
+        const int32_t displacement = target - (at + 4);
+        std::memcpy(&code_[at], &displacement, 4);
+    }
+
+    int Size() const {
+        return (int)code_.size();
+    }
+
+    const vector<uint8_t>& GetCode() const {
+        return code_;
+    }
+
+private:
+    void Byte(const uint8_t& byte) {
+        code_.push_back(byte);
+    }
+
+    void Int(const int32_t& value) {
+        uint8_t bytes[4]; std::memcpy(bytes, &value, 4);
+        code_.insert(code_.end(), bytes, bytes + 4);
+    }
+
+    //ModRM byte addressing reg and [base + offset] with a 32 bit offset
+    void Memory(const int& reg, const int& base, const int& offset) {
+        Byte(0x80 | (reg << 3) | base); Int(offset);
+    }
+
+    //ModRM byte addressing two registers
+    void Direct(const int& reg, const int& rm) {
+        Byte(0xC0 | (reg << 3) | rm);
+    }
+
+    vector<uint8_t> code_;
+};
+
+//Counts the backward jumps of the dispatch engine, records the loops that turn hot and keeps their compiled traces.
+//Traces cover integer compares, arithmetic, steps, assignments and jumps. Anything else, a nested loop or a var that
+//does not hold an int leaves the loop to the interpreter for good
+class TraceJit {
+public:
+    //Results of OnLoop other than the instruction a trace exited at
+    enum LoopResults { INTERPRET = -1, RECORD = -2 };
+
+    //Backward jumps to a loop before it gets recorded, and the longest trace recorded
+    static constexpr int HOT_LOOP = 64, MAX_TRACE_LENGTH = 64;
+
+    explicit TraceJit(Program& program) : program_(program), code_(program.GetCode()), counters_(code_.size(), 0),
+        traces_(code_.size(), nullptr), blocked_(code_.size(), false), recording_(-1) {}
+
+    TraceJit(const TraceJit&) = delete;
+    TraceJit& operator=(const TraceJit&) = delete;
+
+    ~TraceJit() {
+        for (const auto& [memory, size] : mappings_)
+            munmap(memory, size);
+    }
+
+    //Called by every backward jump, with the instruction the loop continues at.
+    //Returns: The instruction to continue at after running the trace of the loop, RECORD to record this iteration, or INTERPRET
+    int OnLoop(const int& head, Var* globals, Var* frame) {
+        if (recording_ != -1) {
+            //The recorded iteration ran into a loop of its own
+            if (head != recording_)
+                Abort();
+            return INTERPRET;
+        }
+        if (traces_[head] != nullptr)
+            return traces_[head](globals, frame);
+        if (blocked_[head] || ++counters_[head] < HOT_LOOP)
+            return INTERPRET;
+
+        recording_ = head; trace_.clear();
+        return RECORD;
+    }
+
+    //Called before each instruction while recording. Compiles the trace once the loop is back at its head.
+    //Returns: Whether to keep recording
+    bool Record(const int& pc, const Var* globals, const Var* frame) {
+        if (recording_ == -1)
+            return false;
+        if (pc == recording_ && !trace_.empty()) {
+            Compile();
+            recording_ = -1;
+            return false;
+        }
+        if ((int)trace_.size() == MAX_TRACE_LENGTH || !CanTrace(pc, globals, frame)) {
+            Abort();
+            return false;
+        }
+
+        trace_.push_back(pc);
+        return true;
+    }
+
+private:
+    using Trace = int (*)(Var* globals, Var* frame);
+
+    //Returns: Whether the instruction can be part of a trace, given the values its operands hold right now
+    bool CanTrace(const int& pc, const Var* globals, const Var* frame) const {
+        const Operands& v = code_[pc].GetOperands();
+        const int opcode = GetCheckedOpcode(code_[pc].GetOpcode());
+
+        switch (opcode) {
+            case OP_LABEL:
+            case OP_JUMP:
+                return true;
+            case OP_IF_COMPARE:
+                if (v[1].GetIndex() > GREATER_EQUAL)
+                    return false;
+                break;
+            case OP_MODIFY:
+                if (v[1].GetIndex() < ADD || v[1].GetIndex() > MODULO)
+                    return false;
+                break;
+            case OP_STEP:
+                if (v[1].GetIndex() != INCREMENT && v[1].GetIndex() != DECREMENT)
+                    return false;
+                break;
+            case OP_SET:
+            case OP_SET_MOD_IF_ZERO:
+                break;
+            case OP_INC_INT_LOOP_LT:
+            case OP_INC_INT_LOOP_LE:
+                if (!HoldsInt(LoopCondition(pc)[2], globals, frame))
+                    return false;
+                break;
+            default:
+                if (!(opcode >= OP_IF_EQ_INT_INT && opcode <= OP_IF_GE_INT_INT) && !(opcode >= OP_ADD_INT_INT && opcode <= OP_MOD_INT_INT)
+                    && opcode != OP_INC_INT && opcode != OP_DEC_INT)
+                    return false;
+                break;
+        }
+
+        for (int i = 0; i < v.Size(); i++)
+            if (IsValue(v[i]) && !HoldsInt(v[i], globals, frame))
+                return false;
+        return true;
+    }
+
+    //Compiles the recorded trace. The trace is entered at the head of the loop and loops back to it by itself
+    void Compile() {
+        const int head = recording_;
+        Assembler a; exits_.clear();
+
+        //Entry guards: every var of the trace holds an int. Nothing in the trace stores anything else, so they hold for every iteration
+        vector<std::pair<int, int>> guarded;
+        for (const int& pc : trace_) {
+            const Operands& v = code_[pc].GetOperands();
+            for (int i = 0; i < v.Size(); i++)
+                GuardInt(a, v[i], head, guarded);
+            const int opcode = GetCheckedOpcode(code_[pc].GetOpcode());
+            if (opcode == OP_INC_INT_LOOP_LT || opcode == OP_INC_INT_LOOP_LE)
+                GuardInt(a, LoopCondition(pc)[2], head, guarded);
+        }
+
+        const int loop = a.Size();
+        for (int i = 0; i < (int)trace_.size(); i++) {
+            const int next = i + 1 < (int)trace_.size() ? trace_[i + 1] : head;
+            if (!CompileInstruction(a, trace_[i], next)) {
+                blocked_[head] = true;
+                return;
+            }
+        }
+        a.Patch(a.Jump(), loop);
+
+        //Exit stubs, one per instruction the interpreter can continue at
+        std::unordered_map<int, int> stubs;
+        for (const auto& [at, pc] : exits_) {
+            if (!stubs.count(pc)) {
+                stubs[pc] = a.Size();
+                a.LoadImmediate(Assembler::EAX, pc); a.Return();
+            }
+            a.Patch(at, stubs[pc]);
+        }
+
+        traces_[head] = Install(a.GetCode());
+        blocked_[head] = traces_[head] == nullptr;
+    }
+
+    //Returns: Whether the instruction compiled. The direction its branch took is read from the next recorded instruction
+    bool CompileInstruction(Assembler& a, const int& pc, const int& next) {
+        const Operands& v = code_[pc].GetOperands();
+        const int opcode = GetCheckedOpcode(code_[pc].GetOpcode());
+
+        if (opcode == OP_LABEL)
+            return next == pc + 1;
+        if (opcode == OP_JUMP)
+            return next == v[0].GetIndex() + 1;
+
+        if (opcode == OP_IF_COMPARE || (opcode >= OP_IF_EQ_INT_INT && opcode <= OP_IF_GE_INT_INT)) {
+            const int op = opcode == OP_IF_COMPARE ? v[1].GetIndex() : opcode - OP_IF_EQ_INT_INT;
+            LoadValue(a, Assembler::EAX, v[0]); LoadValue(a, Assembler::ECX, v[2]);
+            a.Compare(Assembler::EAX, Assembler::ECX);
+            return Branch(a, ConditionOf(op), pc + 1, v[3].GetIndex() + 1, next);
+        }
+
+        if (opcode == OP_MODIFY || (opcode >= OP_ADD_INT_INT && opcode <= OP_MOD_INT_INT)) {
+            const int op = opcode == OP_MODIFY ? v[1].GetIndex() : opcode - OP_ADD_INT_INT + ADD;
+            LoadValue(a, Assembler::EAX, v[0]); LoadValue(a, Assembler::ECX, v[2]);
+            switch (op) {
+                case ADD: a.Add(Assembler::EAX, Assembler::ECX); break;
+                case SUBTRACT: a.Subtract(Assembler::EAX, Assembler::ECX); break;
+                case MULTIPLY: a.Multiply(Assembler::EAX, Assembler::ECX); break;
+                default:
+                    Divide(a, pc);
+                    if (op == MODULO)
+                        a.Move(Assembler::EAX, Assembler::EDX);
+                    break;
+            }
+            a.Store(BaseOf(v[0]), ValueOffset(v[0]), Assembler::EAX);
+            return next == pc + 1;
+        }
+
+        if (opcode == OP_STEP || opcode == OP_INC_INT || opcode == OP_DEC_INT) {
+            const bool increment = opcode == OP_STEP ? v[1].GetIndex() == INCREMENT : opcode == OP_INC_INT;
+            LoadValue(a, Assembler::EAX, v[0]);
+            a.AddImmediate(Assembler::EAX, increment ? 1 : -1);
+            a.Store(BaseOf(v[0]), ValueOffset(v[0]), Assembler::EAX);
+            return next == pc + 1;
+        }
+
+        if (opcode == OP_SET) {
+            LoadValue(a, Assembler::EAX, v[1]);
+            a.Store(BaseOf(v[0]), ValueOffset(v[0]), Assembler::EAX);
+            return next == pc + 1;
+        }
+
+        if (opcode == OP_INC_INT_LOOP_LT || opcode == OP_INC_INT_LOOP_LE) {
+            //i++, then the condition of the loop decides between its body and its end
+            const Operands& condition = LoopCondition(pc);
+            LoadValue(a, Assembler::EAX, v[0]);
+            a.AddImmediate(Assembler::EAX, 1);
+            a.Store(BaseOf(v[0]), ValueOffset(v[0]), Assembler::EAX);
+            LoadValue(a, Assembler::ECX, condition[2]);
+            a.Compare(Assembler::EAX, Assembler::ECX);
+            return Branch(a, opcode == OP_INC_INT_LOOP_LT ? Assembler::JL : Assembler::JLE, v[2].GetIndex() + 2, condition[3].GetIndex() + 1, next);
+        }
+
+        if (opcode == OP_SET_MOD_IF_ZERO) {
+            //x = y % z, then the body of the if statement runs if x is zero
+            LoadValue(a, Assembler::EAX, v[1]); LoadValue(a, Assembler::ECX, v[2]);
+            Divide(a, pc);
+            a.Store(BaseOf(v[0]), ValueOffset(v[0]), Assembler::EDX);
+            a.Test(Assembler::EDX);
+            return Branch(a, Assembler::JE, pc + 3, v[3].GetIndex() + 1, next);
+        }
+        return false;
+    }
+
+    //Guards a branch to go the way it went while recording. 'taken' is where it goes if the condition holds, 'otherwise' where it goes if not.
+    //Returns: Whether the recorded instruction was one of the two
+    bool Branch(Assembler& a, const int& condition, const int& taken, const int& otherwise, const int& next) {
+        if (taken == otherwise)
+            return next == taken;
+        if (next == taken)
+            exits_.emplace_back(a.JumpIf(condition ^ 1), otherwise);
+        else if (next == otherwise)
+            exits_.emplace_back(a.JumpIf(condition), taken);
+        else
+            return false;
+        return true;
+    }
+
+    //Divides eax by ecx. Division by zero and the overflow of INT_MIN / -1 are left to the interpreter, which reports or runs them
+    void Divide(Assembler& a, const int& pc) {
+        a.Test(Assembler::ECX);
+        exits_.emplace_back(a.JumpIf(Assembler::JE), pc);
+        a.CompareImmediate(Assembler::ECX, -1);
+        exits_.emplace_back(a.JumpIf(Assembler::JE), pc);
+        a.Divide(Assembler::ECX);
+    }
+
+    void GuardInt(Assembler& a, const Operand& operand, const int& head, vector<std::pair<int, int>>& guarded) {
+        if (operand.GetKind() != OPERAND_VARIABLE && operand.GetKind() != OPERAND_LOCAL)
+            return;
+        const std::pair<int, int> slot(operand.GetKind(), operand.GetIndex());
+        if (std::find(guarded.begin(), guarded.end(), slot) != guarded.end())
+            return;
+
+        guarded.push_back(slot);
+        a.CompareMemory(BaseOf(operand), ValueOffset(operand) + VAR_TYPE_OFFSET, INT);
+        exits_.emplace_back(a.JumpIf(Assembler::JNE), head);
+    }
+
+    void LoadValue(Assembler& a, const int& reg, const Operand& operand) const {
+        if (operand.GetKind() == OPERAND_CONSTANT)
+            a.LoadImmediate(reg, program_.GetConstant(operand.GetIndex()).GetInt());
+        else
+            a.Load(reg, BaseOf(operand), ValueOffset(operand));
+    }
+
+    //Copies the machine code into memory of its own, which is made executable once it is written.
+    //Returns: The trace, or nullptr if the memory could not be mapped
+    Trace Install(const vector<uint8_t>& code) {
+        const size_t page = (size_t)sysconf(_SC_PAGESIZE), size = (code.size() + page - 1) / page * page;
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+            return nullptr;
+
+        std::memcpy(memory, code.data(), code.size());
+        if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(memory, size);
+            return nullptr;
+        }
+        mappings_.emplace_back(memory, size);
+        return reinterpret_cast<Trace>(memory);
+    }
+
+    void Abort() {
+        blocked_[recording_] = true; recording_ = -1;
+    }
+
+    //Returns: The operands of 'if: i op x, END_n;', which the loop superinstruction at pc evaluates
+    const Operands& LoopCondition(const int& pc) const {
+        return code_[code_[pc].GetOperands()[2].GetIndex() + 1].GetOperands();
+    }
+
+    bool HoldsInt(const Operand& operand, const Var* globals, const Var* frame) const {
+        switch (operand.GetKind()) {
+            case OPERAND_CONSTANT: return program_.GetConstant(operand.GetIndex()).GetType() == INT;
+            case OPERAND_VARIABLE: return globals[operand.GetIndex()].GetType() == INT;
+            case OPERAND_LOCAL: return frame[operand.GetIndex()].GetType() == INT;
+            default: return true;
+        }
+    }
+
+    static bool IsValue(const Operand& operand) {
+        return operand.GetKind() == OPERAND_CONSTANT || operand.GetKind() == OPERAND_VARIABLE || operand.GetKind() == OPERAND_LOCAL;
+    }
+
+    //Locals are addressed from the frame in rsi, globals from the start of memory in rdi
+    static int BaseOf(const Operand& operand) {
+        return operand.GetKind() == OPERAND_LOCAL ? Assembler::RSI : Assembler::RDI;
+    }
+
+    static int ValueOffset(const Operand& operand) {
+        return operand.GetIndex() * (int)sizeof(Var);
+    }
+
+    static int ConditionOf(const int& op) {
+        switch (op) {
+            case EQUAL: return Assembler::JE;
+            case NOT_EQUAL: return Assembler::JNE;
+            case LESS: return Assembler::JL;
+            case GREATER: return Assembler::JG;
+            case LESS_EQUAL: return Assembler::JLE;
+            default: return Assembler::JGE;
+        }
+    }
+
+    Program& program_; vector<InstructionHandle>& code_;
+    vector<int> counters_; vector<Trace> traces_; vector<bool> blocked_;
+
+    //Head of the loop being recorded or -1, the instructions recorded so far, and the jumps to the exits of the trace being compiled
+    int recording_; vector<int> trace_; vector<std::pair<int, int>> exits_;
+    vector<std::pair<void*, size_t>> mappings_;
+};
+
+#endif
+#endif
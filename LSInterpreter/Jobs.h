@@ -0,0 +1,60 @@
+#pragma once
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+using std::vector;
+
+// Splits the work of the front end over threads, for --jobs. Work is split into contiguous ranges, one per job, so each job
+// writes its own part of the output and the results come out in source order without locking.
+
+//Returns: How many jobs to split count items over, so every job gets at least minPerJob of them
+int CountJobs(const int& jobs, const size_t& count, const size_t& minPerJob) {
+    return (int)std::clamp<size_t>(count / std::max<size_t>(minPerJob, 1), 1, (size_t)std::max(jobs, 1));
+}
+
+//Runs work(job) for every job in [0, jobs). The first job runs on the calling thread, the others each on a thread of their own.
+//Once all jobs are done, the exception of the lowest job that threw, if any, is rethrown. It is the one running first otherwise
+template<typename Work>
+void RunJobs(const int& jobs, const Work& work) {
+    if (jobs <= 1) {
+        work(0);
+        return;
+    }
+
+    vector<std::exception_ptr> errors(jobs);
+    auto RunJob = [&work, &errors](const int& job) {
+        try {
+            work(job);
+        }
+        catch (...) {
+            errors[job] = std::current_exception();
+        }
+    };
+
+    vector<std::thread> threads;
+    for (int job = 1; job < jobs; job++)
+        threads.emplace_back(RunJob, job);
+    RunJob(0);
+    for (std::thread& thread : threads)
+        thread.join();
+
+    for (const std::exception_ptr& error : errors)
+        if (error)
+            std::rethrow_exception(error);
+}
+
+//Runs work(begin, end) over [0, count), split into one range per job
+template<typename Work>
+void RunJobs(const int& jobs, const size_t& count, const Work& work) {
+    RunJobs(jobs, [&](const int& job) {
+        work(count * job / jobs, count * (job + 1) / jobs);
+    });
+}
+
+#endif // !JOBS_H
@@ -0,0 +1,1001 @@
+#pragma once
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <iomanip>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+#include "Archetypes.h"
+
+using std::vector;
+
+// Passes that rewrite the compiled program after it has been compiled and before it runs.
+
+// Extra values of the type lattice used by the passes, next to the DataTypes.
+// TYPE_UNSEEN: no assignment has been seen yet, TYPE_ANY: the slot can hold more than one type
+enum TypeLattice {
+    TYPE_UNSEEN = -100,
+    TYPE_ANY = -200
+};
+
+// The specialized opcodes are indexed by operator, so their order has to follow the Operators enum
+static_assert(OP_IF_GE_INT_INT - OP_IF_EQ_INT_INT == GREATER_EQUAL - EQUAL, "Compare opcodes must follow Operators");
+static_assert(OP_IF_GE_DBL_DBL - OP_IF_EQ_DBL_DBL == GREATER_EQUAL - EQUAL, "Compare opcodes must follow Operators");
+static_assert(OP_IF_GE_INT_DBL - OP_IF_LT_INT_DBL == GREATER_EQUAL - LESS, "Compare opcodes must follow Operators");
+static_assert(OP_IF_GE_DBL_INT - OP_IF_LT_DBL_INT == GREATER_EQUAL - LESS, "Compare opcodes must follow Operators");
+static_assert(OP_MOD_INT_INT - OP_ADD_INT_INT == MODULO - ADD, "Arithmetic opcodes must follow Operators");
+static_assert(OP_DIV_DBL_DBL - OP_ADD_DBL_DBL == DIVIDE - ADD, "Arithmetic opcodes must follow Operators");
+static_assert(OP_DIV_DBL_INT - OP_ADD_DBL_INT == DIVIDE - ADD, "Arithmetic opcodes must follow Operators");
+// The unchecked opcodes mirror the specialized ones up to the loop superinstructions
+static_assert(OP_INC_INT_LOOP_LE_UNCHECKED - OP_IF_EQ_INT_INT_UNCHECKED == OP_INC_INT_LOOP_LE - OP_IF_EQ_INT_INT, "Unchecked opcodes must mirror the specialized ones");
+static_assert(OP_INC_INT_LOOP_LE_UNCHECKED == OPCODE_COUNT - 1, "Unchecked opcodes must come last");
+
+//Returns: The joined type of two lattice values
+int JoinTypes(const int& a, const int& b) {
+    if (a == TYPE_UNSEEN)
+        return b;
+    if (b == TYPE_UNSEEN || a == b)
+        return a;
+    return TYPE_ANY;
+}
+
+//Returns: Form of a specialized opcode that skips its type guard, or the opcode itself if it has none
+int GetUncheckedOpcode(const int& opcode) {
+    if (opcode >= OP_IF_EQ_INT_INT && opcode <= OP_INC_INT_LOOP_LE)
+        return opcode + (OP_IF_EQ_INT_INT_UNCHECKED - OP_IF_EQ_INT_INT);
+    return opcode;
+}
+
+//Returns: Form of an unchecked opcode that guards its types, or the opcode itself
+int GetCheckedOpcode(const int& opcode) {
+    if (opcode >= OP_IF_EQ_INT_INT_UNCHECKED)
+        return opcode - (OP_IF_EQ_INT_INT_UNCHECKED - OP_IF_EQ_INT_INT);
+    return opcode;
+}
+
+//Returns: Generic opcode a specialized opcode falls back to when its type guard fails
+int GetGenericOpcode(const int& input) {
+    const int opcode = GetCheckedOpcode(input);
+    if (opcode >= OP_IF_EQ_INT_INT && opcode <= OP_IF_GE_DBL_INT)
+        return OP_IF_COMPARE;
+    if (opcode >= OP_ADD_INT_INT && opcode <= OP_DIV_DBL_INT)
+        return OP_MODIFY;
+    if (opcode >= OP_INC_INT && opcode <= OP_INC_INT_LOOP_LE)
+        return OP_STEP;
+    if (opcode == OP_SET_MOD_IF_ZERO)
+        return OP_SET;
+    return opcode;
+}
+
+//Returns: Opcode specialized for an operator and operand types, or the generic opcode if there is none
+int GetSpecializedOpcode(const int& generic, const int& op, const int& type1, const int& type2) {
+    const bool isNumeric1 = type1 == INT || type1 == DOUBLE;
+    const bool isNumeric2 = type2 == INT || type2 == DOUBLE;
+
+    switch (generic) {
+        case OP_IF_COMPARE: {
+            if (!isNumeric1 || !isNumeric2 || op < EQUAL || op > GREATER_EQUAL)
+                return generic;
+            if (type1 == type2)
+                return (type1 == INT ? OP_IF_EQ_INT_INT : OP_IF_EQ_DBL_DBL) + (op - EQUAL);
+            // An int is never equal to a double, leave that to the generic instruction
+            if (op == EQUAL || op == NOT_EQUAL)
+                return generic;
+            return (type1 == INT ? OP_IF_LT_INT_DBL : OP_IF_LT_DBL_INT) + (op - LESS);
+        }
+        case OP_MODIFY: {
+            if (op < ADD || op > MODULO)
+                return generic;
+            if (type1 == INT && type2 == INT)
+                return OP_ADD_INT_INT + (op - ADD);
+            // Int targets modified by doubles turn into doubles, which the generic instruction handles
+            if (type1 == DOUBLE && isNumeric2 && op != MODULO)
+                return (type2 == DOUBLE ? OP_ADD_DBL_DBL : OP_ADD_DBL_INT) + (op - ADD);
+            return generic;
+        }
+        case OP_STEP: {
+            if (op != INCREMENT && op != DECREMENT)
+                return generic;
+            if (type1 == INT)
+                return op == INCREMENT ? OP_INC_INT : OP_DEC_INT;
+            if (type1 == DOUBLE)
+                return op == INCREMENT ? OP_INC_DBL : OP_DEC_DBL;
+            return generic;
+        }
+        default:
+            return generic;
+    }
+}
+
+//Returns: Whether an opcode is specialized. If so, also returns the operator and the operand types it is specialized for
+bool GetSpecialization(const int& opcode, int& op, int& type1, int& type2) {
+    const int checked = GetCheckedOpcode(opcode), generic = GetGenericOpcode(opcode);
+    if (checked == generic)
+        return false;
+
+    for (op = EQUAL; op <= DECREMENT; op++)
+        for (const int a : { INT, DOUBLE })
+            for (const int b : { INT, DOUBLE })
+                if (GetSpecializedOpcode(generic, op, a, b) == checked) {
+                    type1 = a; type2 = b;
+                    return true;
+                }
+    return false;
+}
+
+//Numbers every memory slot an operand can name: the globals first, then the frame slots of each function in turn
+class SlotTable {
+public:
+    explicit SlotTable(Program& program) : owner_(program.GetCode().size(), -1), size_(program.GetIdentifierCount()) {
+        const vector<FunctionScope>& functions = program.GetFunctions();
+        for (int f = 0; f < (int)functions.size(); f++) {
+            localBase_.push_back(size_); size_ += functions[f].GetFrameSize();
+            for (int i = functions[f].GetBegin(); i < functions[f].GetEnd() && i < (int)owner_.size(); i++)
+                owner_[i] = f;
+        }
+    }
+
+    //Returns: Entry of the slot an operand of the instruction at an index names, or -1 if it names none
+    int Find(const Operand& operand, const int& instruction) const {
+        if (operand.GetKind() == OPERAND_VARIABLE)
+            return operand.GetIndex();
+        if (operand.GetKind() == OPERAND_LOCAL && owner_[instruction] != -1)
+            return localBase_[owner_[instruction]] + operand.GetIndex();
+        return -1;
+    }
+
+    //Returns: Function the instruction at an index is in, or -1
+    int GetOwner(const int& instruction) const {
+        return owner_[instruction];
+    }
+
+    //Returns: Entry of a parameter of a function
+    int FindParam(const int& function, const int& param) const {
+        return localBase_[function] + param;
+    }
+
+    int GetSize() const {
+        return size_;
+    }
+
+private:
+    vector<int> owner_, localBase_; int size_;
+};
+
+//Returns: Whether two operands name the same memory slot
+bool IsSameSlot(const Operand& a, const Operand& b) {
+    return (a.GetKind() == OPERAND_VARIABLE || a.GetKind() == OPERAND_LOCAL) && a.GetKind() == b.GetKind() && a.GetIndex() == b.GetIndex();
+}
+
+//Returns: Whether the operand at index is the slot an instruction writes, rather than a value it reads
+bool IsWriteOperand(const int& opcode, const int& index) {
+    switch (opcode) {
+        case OP_VAR:
+        case OP_VAR_DECLARE:
+        case OP_SET:
+        case OP_MODIFY:
+        case OP_STEP:
+        case OP_APPEND:
+        case OP_SQRT:
+        case OP_ABS:
+        case OP_RAND:
+        case OP_MILLIS:
+        case OP_SECONDS:
+        case OP_INPUT:
+        case OP_READ:
+        case OP_POP:
+        case OP_DELETE:
+            return index == 0;
+        case OP_INPUT_PROMPT:
+            return index == 1;
+        default:
+            return false;
+    }
+}
+
+//Returns: Whether execution never continues with the next instruction after an instruction
+bool EndsFlow(const int& opcode) {
+    return opcode == OP_JUMP || opcode == OP_RETURN || opcode == OP_RETURN_VALUE || opcode == OP_EXIT || opcode == OP_HALT;
+}
+
+//Returns: Number of instructions in the straight line code the program starts with, which ends at the first label
+//or instruction that can jump. Everything in it runs in order before anything else
+int GetEntryLength(const vector<InstructionHandle>& code) {
+    auto IsStraight = [](const InstructionHandle& instruction) {
+        const Operands& v = instruction.GetOperands();
+        for (int j = 0; j < v.Size(); j++)
+            if (v[j].GetKind() == OPERAND_LABEL)
+                return false;
+        return instruction.GetOpcode() != OP_LABEL && !EndsFlow(instruction.GetOpcode());
+    };
+
+    int entry = 0;
+    while (entry < (int)code.size() && IsStraight(code[entry]))
+        entry++;
+    return entry;
+}
+
+//Removes the marked instructions. Label operands pointing at a removed instruction point at the last instruction kept before it,
+//as execution advances past the instruction jumped to and so continues with the first instruction kept after it
+void RemoveInstructions(Program& program, const vector<bool>& removed) {
+    vector<InstructionHandle>& code = program.GetCode();
+
+    vector<int> newIndex(code.size()); int kept = 0;
+    for (size_t i = 0; i < code.size(); i++)
+        newIndex[i] = removed[i] ? kept - 1 : kept++;
+
+    for (size_t i = 0; i < code.size(); i++) {
+        if (removed[i])
+            continue;
+        Operands operands = code[i].GetOperands();
+        for (int j = 0; j < operands.Size(); j++)
+            if (operands[j].GetKind() == OPERAND_LABEL)
+                operands[j].SetIndex(newIndex[operands[j].GetIndex()]);
+        code[i].SetOperands(operands);
+        code[newIndex[i]] = code[i];
+    }
+
+    code.resize(kept);
+    program.RemapLabels(newIndex);
+}
+
+//Returns: The lattice type of an operand of the instruction at an index, given the types predicted for every slot
+int GetOperandType(const Program& program, const SlotTable& slots, const vector<int>& slotTypes, const Operand& operand, const int& instruction) {
+    if (operand.GetKind() == OPERAND_CONSTANT)
+        return program.GetConstant(operand.GetIndex()).GetType();
+
+    const int slot = slots.Find(operand, instruction);
+    return slot == -1 ? TYPE_ANY : slotTypes[slot];
+}
+
+//Returns: The type every slot is expected to hold, found by joining the types of all values assigned to it.
+//Flow insensitive, a slot assigned values of different types, from pop or from input is TYPE_ANY.
+//Parameters get the types of the arguments bound to them.
+vector<int> PredictSlotTypes(Program& program, const SlotTable& slots) {
+    vector<int> slotTypes(slots.GetSize(), TYPE_UNSEEN);
+    const vector<InstructionHandle>& code = program.GetCode();
+
+    //Joins a type into a slot. Returns: whether the slot changed
+    auto AssignSlot = [&slotTypes](const int& slot, const int& type) {
+        if (slot == -1)
+            return false;
+        int& slotType = slotTypes[slot];
+        const int joined = JoinTypes(slotType, type);
+        if (joined == slotType)
+            return false;
+        slotType = joined;
+        return true;
+    };
+
+    //Iterate until no slot changes. Every slot can only change twice, so this terminates quickly
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        //Types of the arguments bound for the next call
+        vector<int> argTypes;
+
+        for (int i = 0; i < (int)code.size(); i++) {
+            const Operands& v = code[i].GetOperands();
+            auto Assign = [&](const Operand& target, const int& type) {
+                return AssignSlot(slots.Find(target, i), type);
+            };
+            auto TypeOf = [&](const Operand& operand) {
+                return GetOperandType(program, slots, slotTypes, operand, i);
+            };
+
+            switch (code[i].GetOpcode()) {
+                case OP_VAR:
+                case OP_SET:
+                    changed |= Assign(v[0], TypeOf(v[1]));
+                    break;
+                case OP_MODIFY: {
+                    const int type1 = TypeOf(v[0]), type2 = TypeOf(v[2]);
+                    // Ints modified by doubles become doubles
+                    if (type1 == INT && type2 == DOUBLE)
+                        changed |= Assign(v[0], DOUBLE);
+                    else if (type1 == INT && type2 != INT && type2 != TYPE_UNSEEN)
+                        changed |= Assign(v[0], TYPE_ANY);
+                    break;
+                }
+                case OP_RAND:
+                case OP_SECONDS:
+                    changed |= Assign(v[0], DOUBLE);
+                    break;
+                case OP_MILLIS:
+                    changed |= Assign(v[0], INT);
+                    break;
+                case OP_APPEND:
+                    changed |= Assign(v[0], STRING);
+                    break;
+                case OP_POP:
+                case OP_INPUT:
+                case OP_READ:
+                    changed |= Assign(v[0], TYPE_ANY);
+                    break;
+                case OP_INPUT_PROMPT:
+                    changed |= Assign(v[1], TYPE_ANY);
+                    break;
+                case OP_ARG:
+                    argTypes.push_back(TypeOf(v[0]));
+                    break;
+                case OP_ARG_POP:
+                    argTypes.push_back(TYPE_ANY);
+                    break;
+                case OP_CALL: {
+                    const int function = v[1].GetIndex();
+                    if (function != -1)
+                        for (int param = 0; param < (int)argTypes.size() && param < program.GetFunction(function).GetParamCount(); param++)
+                            changed |= AssignSlot(slots.FindParam(function, param), argTypes[param]);
+                    argTypes.clear();
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+    }
+
+    return slotTypes;
+}
+
+//Types of the operands of an instruction proven at load time, TYPE_ANY where nothing is proven
+using OperandTypes = std::array<int, Operands::MAX_OPERANDS>;
+
+//Returns: The type of every operand of every instruction that holds whenever the instruction runs.
+//Locals are followed through the flow of their function, starting out undefined apart from the parameters, which get the types
+//of the arguments bound to them. Pops right after a call get the types the function returns.
+//Globals are not followed through calls, so one is only proven if its declaration is in the straight line code the program starts with
+//and every write to it keeps its type. Runs while the labels are still in place
+vector<OperandTypes> InferTypes(Program& program, const SlotTable& slots) {
+    const vector<InstructionHandle>& code = program.GetCode();
+    const vector<FunctionScope>& functions = program.GetFunctions();
+    const int size = (int)code.size(), functionCount = (int)functions.size();
+
+    OperandTypes unknown; unknown.fill(TYPE_ANY);
+    vector<OperandTypes> proven(size, unknown);
+
+    //The declaration of every global, -1 if its first write is not a 'var' that runs first
+    const int entry = GetEntryLength(code);
+    vector<int> declaration(program.GetIdentifierCount(), -1); vector<bool> written(program.GetIdentifierCount());
+    for (int i = 0; i < size; i++) {
+        const Operands& v = code[i].GetOperands();
+        for (int j = 0; j < v.Size(); j++) {
+            if (v[j].GetKind() != OPERAND_VARIABLE || !IsWriteOperand(code[i].GetOpcode(), j) || written[v[j].GetIndex()])
+                continue;
+            written[v[j].GetIndex()] = true;
+            if (code[i].GetOpcode() == OP_VAR && i < entry)
+                declaration[v[j].GetIndex()] = i;
+        }
+    }
+
+    vector<int> globalTypes(program.GetIdentifierCount(), TYPE_UNSEEN), returnTypes(functionCount, TYPE_UNSEEN);
+    vector<vector<int>> paramTypes(functionCount);
+    for (int f = 0; f < functionCount; f++)
+        paramTypes[f].assign(functions[f].GetParamCount(), TYPE_UNSEEN);
+    vector<bool> called(functionCount), returnsNothing(functionCount);
+
+    //Types of the locals before every instruction, for the instructions reached
+    vector<vector<int>> states(size); vector<bool> reached(size);
+
+    //Joins a type into a global, parameter or return type. Sets changed if that widened it
+    bool changed = true;
+    auto Widen = [&changed](int& into, const int& type) {
+        const int joined = JoinTypes(into, type);
+        if (joined != into) {
+            into = joined; changed = true;
+        }
+    };
+    auto TypeOf = [&](const Operand& operand, const int& i, const vector<int>& state) {
+        switch (operand.GetKind()) {
+            case OPERAND_CONSTANT: return program.GetConstant(operand.GetIndex()).GetType();
+            case OPERAND_LOCAL: return operand.GetIndex() < (int)state.size() ? state[operand.GetIndex()] : (int)TYPE_ANY;
+            case OPERAND_VARIABLE: {
+                const int found = declaration[operand.GetIndex()];
+                return found != -1 && found < i ? globalTypes[operand.GetIndex()] : (int)TYPE_ANY;
+            }
+            default: return (int)TYPE_ANY;
+        }
+    };
+    auto Write = [&](const Operand& target, const int& type, vector<int>& state) {
+        if (target.GetKind() == OPERAND_LOCAL && target.GetIndex() < (int)state.size())
+            state[target.GetIndex()] = type;
+        else if (target.GetKind() == OPERAND_VARIABLE && declaration[target.GetIndex()] != -1)
+            Widen(globalTypes[target.GetIndex()], type);
+    };
+    auto IsConcrete = [](const int& type) {
+        return type == INT || type == DOUBLE || type == STRING || type == BOOL;
+    };
+
+    //Iterate until the globals, parameters and return types stop widening. The flow within each function starts over every time
+    bool giveUp = false;
+    while (changed && !giveUp) {
+        changed = false;
+        std::fill(reached.begin(), reached.end(), false);
+
+        for (int f = -1; f < functionCount && !giveUp; f++) {
+            if (f != -1 && !called[f])
+                continue;
+
+            const int begin = f == -1 ? 0 : functions[f].GetBegin();
+            vector<int> initial(f == -1 ? 0 : functions[f].GetFrameSize(), UNDEFINED);
+            for (int p = 0; f != -1 && p < functions[f].GetParamCount(); p++)
+                initial[p] = paramTypes[f][p];
+
+            vector<int> pending;
+            //Joins a state into the state before an instruction, queueing it if that widened it
+            auto Flow = [&](const int& target, const vector<int>& state) {
+                if (target < 0 || target >= size)
+                    return;
+                if (slots.GetOwner(target) != f) {
+                    giveUp = true; return;
+                }
+                if (!reached[target]) {
+                    reached[target] = true; states[target] = state; pending.push_back(target);
+                    return;
+                }
+                bool widened = false;
+                for (size_t k = 0; k < state.size(); k++) {
+                    const int joined = JoinTypes(states[target][k], state[k]);
+                    widened |= joined != states[target][k]; states[target][k] = joined;
+                }
+                if (widened)
+                    pending.push_back(target);
+            };
+            Flow(begin, initial);
+
+            while (!pending.empty() && !giveUp) {
+                const int i = pending.back(); pending.pop_back();
+                vector<int> state = states[i];
+                const Operands& v = code[i].GetOperands();
+                const int opcode = code[i].GetOpcode();
+                const int target = v.Size() > 0 ? TypeOf(v[0], i, state) : (int)TYPE_ANY;
+
+                switch (opcode) {
+                    case OP_VAR:
+                    case OP_SET:
+                        Write(v[0], TypeOf(v[1], i, state), state);
+                        break;
+                    case OP_VAR_DECLARE:
+                        Write(v[0], ERROR, state);
+                        break;
+                    case OP_MODIFY: {
+                        // Ints modified by doubles become doubles, anything else keeps its type or is an error
+                        const int value = TypeOf(v[2], i, state);
+                        if (target == INT && (value == DOUBLE || value == TYPE_ANY))
+                            Write(v[0], value == DOUBLE ? DOUBLE : (int)TYPE_ANY, state);
+                        else if (target == TYPE_ANY)
+                            Write(v[0], TYPE_ANY, state);
+                        break;
+                    }
+                    case OP_RAND:
+                    case OP_SECONDS:
+                        Write(v[0], DOUBLE, state);
+                        break;
+                    case OP_MILLIS:
+                        Write(v[0], INT, state);
+                        break;
+                    case OP_APPEND:
+                        Write(v[0], STRING, state);
+                        break;
+                    case OP_INPUT:
+                    case OP_INPUT_PROMPT:
+                    case OP_READ: {
+                        // Input keeps the type of an initialized variable
+                        const Operand& variable = v[opcode == OP_INPUT_PROMPT ? 1 : 0];
+                        if (!IsConcrete(TypeOf(variable, i, state)))
+                            Write(variable, TYPE_ANY, state);
+                        break;
+                    }
+                    case OP_POP: {
+                        // Pop keeps the type of an initialized variable, or fails. Otherwise the variable gets the value returned by the call before
+                        if (IsConcrete(target))
+                            break;
+                        const int function = i > 0 && code[i - 1].GetOpcode() == OP_CALL ? code[i - 1].GetOperands()[1].GetIndex() : -1;
+                        Write(v[0], target == TYPE_ANY || function == -1 || returnsNothing[function] ? (int)TYPE_ANY : returnTypes[function], state);
+                        break;
+                    }
+                    case OP_DELETE:
+                        Write(v[0], UNDEFINED, state);
+                        break;
+                    case OP_CALL: {
+                        const int function = v[1].GetIndex();
+                        if (function == -1) {
+                            // A label run in the frame of the caller can write anything
+                            std::fill(state.begin(), state.end(), (int)TYPE_ANY);
+                            break;
+                        }
+                        if (!called[function]) {
+                            called[function] = true; changed = true;
+                        }
+
+                        // The arguments are bound right before the call
+                        int first = i;
+                        while (first > 0 && (code[first - 1].GetOpcode() == OP_ARG || code[first - 1].GetOpcode() == OP_ARG_POP))
+                            first--;
+                        for (int p = 0; p < functions[function].GetParamCount(); p++) {
+                            const int arg = first + p;
+                            if (arg >= i)
+                                Widen(paramTypes[function][p], UNDEFINED);
+                            else
+                                Widen(paramTypes[function][p], code[arg].GetOpcode() == OP_ARG ? TypeOf(code[arg].GetOperands()[0], i, state) : (int)TYPE_ANY);
+                        }
+                        break;
+                    }
+                    case OP_RETURN:
+                        if (f != -1 && !returnsNothing[f]) {
+                            returnsNothing[f] = true; changed = true;
+                        }
+                        break;
+                    case OP_RETURN_VALUE:
+                        if (f != -1)
+                            Widen(returnTypes[f], TypeOf(v[0], i, state));
+                        break;
+                    default:
+                        break;
+                }
+
+                for (int j = 0; j < v.Size(); j++)
+                    if (v[j].GetKind() == OPERAND_LABEL && !(opcode == OP_CALL && v[1].GetIndex() != -1))
+                        Flow(v[j].GetIndex(), state);
+                if (!EndsFlow(opcode))
+                    Flow(i + 1, state);
+            }
+        }
+    }
+
+    if (giveUp)
+        return proven;
+
+    for (int i = 0; i < size; i++) {
+        if (!reached[i])
+            continue;
+        const Operands& v = code[i].GetOperands();
+        for (int j = 0; j < v.Size(); j++) {
+            const int type = TypeOf(v[j], i, states[i]);
+            proven[i][j] = IsConcrete(type) ? type : (int)TYPE_ANY;
+        }
+    }
+    return proven;
+}
+
+//Returns: Index of the first instruction that fails on the types proven for its operands, or -1. The message is the one
+//the instruction would fail with when it runs
+int FindTypeError(Program& program, const vector<OperandTypes>& proven, string& error) {
+    const vector<InstructionHandle>& code = program.GetCode();
+    auto IsNumeric = [](const int& type) {
+        return type == INT || type == DOUBLE;
+    };
+
+    for (int i = 0; i < (int)code.size(); i++) {
+        const Operands& v = code[i].GetOperands();
+        const int type1 = proven[i][0], type2 = proven[i][2];
+
+        switch (code[i].GetOpcode()) {
+            case OP_MODIFY: {
+                if (type1 == TYPE_ANY || type2 == TYPE_ANY)
+                    break;
+                const int op = v[1].GetIndex();
+                if (type1 != type2 && !(IsNumeric(type1) && IsNumeric(type2)))
+                    error = "Arithmetic operation received wrong type. Got: '" + IntToType(type2) + "' Expected: '" + IntToType(type1) + "'";
+                else if (type1 == BOOL)
+                    error = "Cannot perform arithmetic operation on type 'bool'";
+                else if (type1 == STRING && op != ADD)
+                    error = "Cannot use operator '" + IntToOperator(op) + "' on a string";
+                else if (op == MODULO && (type1 == DOUBLE || type2 == DOUBLE))
+                    error = "Modulo operation is only valid for integral types";
+                break;
+            }
+            case OP_IF_COMPARE: {
+                if (type1 == TYPE_ANY || type2 == TYPE_ANY)
+                    break;
+                const int op = v[1].GetIndex();
+                if (type1 != type2 && !(IsNumeric(type1) && IsNumeric(type2)))
+                    error = "Comparing different types. Type1: '" + IntToType(type1) + "' Type2: '" + IntToType(type2) + "'";
+                else if (op != EQUAL && op != NOT_EQUAL && !IsNumeric(type1))
+                    error = "Cannot use relational operators on Type: '" + IntToType(type1) + "'";
+                break;
+            }
+            case OP_STEP:
+                if (type1 != TYPE_ANY && !IsNumeric(type1))
+                    error = "Cannot use operator '" + IntToOperator(v[1].GetIndex()) + "' on type '" + IntToType(type1) + "'";
+                break;
+            case OP_SQRT:
+                if (type1 != TYPE_ANY && !IsNumeric(type1))
+                    error = "Square root operation received wrong type. Got: '" + IntToType(type1) + "'";
+                break;
+            case OP_ABS:
+                if (type1 != TYPE_ANY && !IsNumeric(type1))
+                    error = "Absolute operation received wrong type. Got: '" + IntToType(type1) + "'";
+                break;
+            case OP_EXIT:
+                if (type1 != TYPE_ANY && type1 != INT)
+                    error = "Exit requires argument type: 'int' got: '" + IntToType(type1) + "'";
+                break;
+            default:
+                break;
+        }
+
+        if (!error.empty())
+            return i;
+    }
+    return -1;
+}
+
+//Returns: Whether 'a op b' can be worked out at load time, in which case it is stored in result.
+//Follows Modify, everything Modify reports as an error is left to run time
+bool FoldArithmetic(const Var& a, const Var& b, const int& op, Var& result) {
+    const int type1 = a.GetType(), type2 = b.GetType();
+    if (type1 == STRING && type2 == STRING && op == ADD) {
+        result = Var(a.GetString() + b.GetString());
+        return true;
+    }
+    if ((type1 != INT && type1 != DOUBLE) || (type2 != INT && type2 != DOUBLE))
+        return false;
+
+    if (type1 == INT && type2 == INT) {
+        const int val1 = a.GetInt(), val2 = b.GetInt();
+        switch (op) {
+            case ADD: result = Var(val1 + val2); return true;
+            case SUBTRACT: result = Var(val1 - val2); return true;
+            case MULTIPLY: result = Var(val1 * val2); return true;
+            case DIVIDE: if (val2 == 0) return false; result = Var(val1 / val2); return true;
+            case MODULO: if (val2 == 0) return false; result = Var(val1 % val2); return true;
+            default: return false;
+        }
+    }
+
+    // Any double operand makes the result a double
+    const double val1 = type1 == INT ? a.GetInt() : a.GetDouble(), val2 = type2 == INT ? b.GetInt() : b.GetDouble();
+    switch (op) {
+        case ADD: result = Var(val1 + val2); return true;
+        case SUBTRACT: result = Var(val1 - val2); return true;
+        case MULTIPLY: result = Var(val1 * val2); return true;
+        case DIVIDE: if (val2 == 0.0) return false; result = Var(val1 / val2); return true;
+        default: return false;
+    }
+}
+
+//Returns: Whether 'a op b' can be decided at load time, in which case the outcome is stored in holds.
+//Follows IfCompare, everything IfCompare reports as an error is left to run time
+bool FoldComparison(const Var& a, const Var& b, const int& op, bool& holds) {
+    const int type1 = a.GetType(), type2 = b.GetType();
+    const bool isNumeric1 = type1 == INT || type1 == DOUBLE, isNumeric2 = type2 == INT || type2 == DOUBLE;
+    if (type1 != type2 && !(isNumeric1 && isNumeric2))
+        return false;
+
+    if (op == EQUAL || op == NOT_EQUAL) {
+        holds = (a == b) == (op == EQUAL);
+        return true;
+    }
+    if (!isNumeric1)
+        return false;
+
+    const double val1 = type1 == INT ? a.GetInt() : a.GetDouble(), val2 = type2 == INT ? b.GetInt() : b.GetDouble();
+    switch (op) {
+        case LESS: holds = val1 < val2; return true;
+        case GREATER: holds = val1 > val2; return true;
+        case LESS_EQUAL: holds = val1 <= val2; return true;
+        case GREATER_EQUAL: holds = val1 >= val2; return true;
+        default: return false;
+    }
+}
+
+//Replaces every read of a global by its value, if the global is only ever written by one 'var' with a literal,
+//and that declaration is in the straight line code the program starts with, so it runs before everything else.
+//The declaration stays, as the global can still be printed, deleted or declared again
+void PropagateConstants(Program& program) {
+    vector<InstructionHandle>& code = program.GetCode();
+
+    //The declaration of every global, -1 while none was seen, -2 if it is written anywhere else
+    vector<int> declaration(program.GetIdentifierCount(), -1);
+    for (int i = 0; i < (int)code.size(); i++) {
+        const Operands& v = code[i].GetOperands();
+        for (int j = 0; j < v.Size(); j++) {
+            if (v[j].GetKind() != OPERAND_VARIABLE || !IsWriteOperand(code[i].GetOpcode(), j))
+                continue;
+            int& found = declaration[v[j].GetIndex()];
+            found = found == -1 && code[i].GetOpcode() == OP_VAR && v[1].GetKind() == OPERAND_CONSTANT ? i : -2;
+        }
+    }
+
+    const int entry = GetEntryLength(code);
+
+    for (int i = 0; i < (int)code.size(); i++) {
+        Operands operands = code[i].GetOperands(); bool changed = false;
+        for (int j = 0; j < operands.Size(); j++) {
+            if (operands[j].GetKind() != OPERAND_VARIABLE || IsWriteOperand(code[i].GetOpcode(), j))
+                continue;
+            const int found = declaration[operands[j].GetIndex()];
+            if (found >= 0 && found < entry && found < i) {
+                operands[j] = code[found].GetOperands()[1]; changed = true;
+            }
+        }
+        if (changed)
+            code[i].SetOperands(operands);
+    }
+}
+
+//Works out what the instructions of every straight line block compute from literals. Tracks the value of the slots assigned literals,
+//replaces reads of them by the value, turns arithmetic on them into assignments of the result and decides comparisons on them.
+//An if that always holds is removed, one that never holds becomes a jump
+void FoldConstants(Program& program) {
+    vector<InstructionHandle>& code = program.GetCode();
+    vector<bool> removed(code.size());
+
+    //Constant held by every slot with a known value. Locals are keyed below the globals.
+    //Only valid within a block: a label can be reached from anywhere, calls can write every global
+    std::unordered_map<int, int> known;
+    auto KeyOf = [](const Operand& operand) {
+        if (operand.GetKind() == OPERAND_VARIABLE)
+            return operand.GetIndex();
+        return operand.GetKind() == OPERAND_LOCAL ? -1 - operand.GetIndex() : INT_MIN;
+    };
+    //Returns: The constant an operand holds, or -1 if it is not known
+    auto ConstantOf = [&](const Operand& operand) {
+        if (operand.GetKind() == OPERAND_CONSTANT)
+            return operand.GetIndex();
+        auto found = known.find(KeyOf(operand));
+        return found == known.end() ? -1 : found->second;
+    };
+
+    for (int i = 0; i < (int)code.size(); i++) {
+        InstructionHandle& instruction = code[i];
+        const int opcode = instruction.GetOpcode();
+        Operands v = instruction.GetOperands();
+
+        if (opcode == OP_LABEL) {
+            known.clear();
+            continue;
+        }
+
+        //Replace reads of known slots by their value
+        for (int j = 0; j < v.Size(); j++) {
+            if (IsWriteOperand(opcode, j) || (v[j].GetKind() != OPERAND_VARIABLE && v[j].GetKind() != OPERAND_LOCAL))
+                continue;
+            const int constant = ConstantOf(v[j]);
+            if (constant != -1)
+                v[j] = Operand(OPERAND_CONSTANT, constant);
+        }
+        instruction.SetOperands(v);
+
+        switch (opcode) {
+            case OP_VAR:
+            case OP_SET:
+                if (v[1].GetKind() == OPERAND_CONSTANT) {
+                    known[KeyOf(v[0])] = v[1].GetIndex();
+                    continue;
+                }
+                break;
+            case OP_MODIFY:
+            case OP_STEP: {
+                const int constant = ConstantOf(v[0]); Var result;
+                if (constant == -1)
+                    break;
+
+                const bool folded = opcode == OP_MODIFY
+                    ? v[2].GetKind() == OPERAND_CONSTANT && FoldArithmetic(program.GetConstant(constant), program.GetConstant(v[2].GetIndex()), v[1].GetIndex(), result)
+                    : FoldArithmetic(program.GetConstant(constant), Var(1), v[1].GetIndex() == INCREMENT ? ADD : SUBTRACT, result);
+                if (!folded)
+                    break;
+
+                // The slot is assigned the result instead
+                Operands assignment; assignment.Push(v[0]); assignment.Push(Operand(OPERAND_CONSTANT, program.AddConstant(result)));
+                instruction.SetOpcode(OP_SET); instruction.SetOperands(assignment);
+                known[KeyOf(v[0])] = assignment[1].GetIndex();
+                continue;
+            }
+            case OP_IF_COMPARE:
+            case OP_IF_TRUE:
+            case OP_IF_FALSE: {
+                bool holds = false;
+                if (opcode == OP_IF_COMPARE) {
+                    if (v[0].GetKind() != OPERAND_CONSTANT || v[2].GetKind() != OPERAND_CONSTANT
+                        || !FoldComparison(program.GetConstant(v[0].GetIndex()), program.GetConstant(v[2].GetIndex()), v[1].GetIndex(), holds))
+                        break;
+                }
+                else {
+                    // Follows IfTrue and IfFalse: a literal is never uninitialized, so only a bool decides anything
+                    if (v[0].GetKind() != OPERAND_CONSTANT)
+                        break;
+                    const Var& value = program.GetConstant(v[0].GetIndex());
+                    holds = opcode == OP_IF_TRUE ? !(value.GetType() == BOOL && !value.GetBool()) : value.GetType() == BOOL && !value.GetBool();
+                }
+
+                if (holds) {
+                    removed[i] = true;
+                }
+                else {
+                    Operands jump; jump.Push(v[v.Size() - 1]);
+                    instruction.SetOpcode(OP_JUMP); instruction.SetOperands(jump);
+                }
+                continue;
+            }
+            case OP_CALL:
+                // A label run in the frame of the caller can write its locals too
+                if (v[1].GetIndex() == -1) {
+                    known.clear();
+                    continue;
+                }
+                for (auto it = known.begin(); it != known.end();)
+                    it = it->first >= 0 ? known.erase(it) : std::next(it);
+                continue;
+            default:
+                break;
+        }
+
+        //Anything else the instruction writes is no longer known
+        for (int j = 0; j < v.Size(); j++)
+            if (IsWriteOperand(opcode, j))
+                known.erase(KeyOf(v[j]));
+    }
+
+    RemoveInstructions(program, removed);
+}
+
+//Removes the instructions no path from the start of the program reaches, such as the jumps around functions after 'exit',
+//and the labels nothing jumps to
+void EliminateDeadCode(Program& program) {
+    const vector<InstructionHandle>& code = program.GetCode();
+    const int size = (int)code.size();
+
+    vector<bool> reachable(size); vector<int> pending{ 0 };
+    while (!pending.empty()) {
+        const int i = pending.back(); pending.pop_back();
+        if (i < 0 || i >= size || reachable[i])
+            continue;
+        reachable[i] = true;
+
+        //Calls come back to the next instruction, returns are covered by that
+        const Operands& v = code[i].GetOperands();
+        for (int j = 0; j < v.Size(); j++)
+            if (v[j].GetKind() == OPERAND_LABEL)
+                pending.push_back(v[j].GetIndex());
+        if (!EndsFlow(code[i].GetOpcode()))
+            pending.push_back(i + 1);
+    }
+
+    vector<bool> isTarget(size);
+    for (int i = 0; i < size; i++) {
+        const Operands& v = code[i].GetOperands();
+        for (int j = 0; j < v.Size() && reachable[i]; j++)
+            if (v[j].GetKind() == OPERAND_LABEL && v[j].GetIndex() >= 0 && v[j].GetIndex() < size)
+                isTarget[v[j].GetIndex()] = true;
+    }
+
+    //The end of the program stays, both engines stop there
+    vector<bool> removed(size);
+    for (int i = 0; i < size; i++)
+        removed[i] = code[i].GetOpcode() != OP_HALT && (!reachable[i] || (code[i].GetOpcode() == OP_LABEL && !isTarget[i]));
+    RemoveInstructions(program, removed);
+}
+
+//Rewrites comparisons, arithmetic and increments into opcodes specialized for the operator and the types of their operands.
+//Types proven at load time are used as they are and select the unchecked opcodes. Otherwise the types are predicted,
+//and the specialized instructions guard them at run time, falling back to the generic instruction on a mismatch.
+void SpecializeInstructions(Program& program, const vector<OperandTypes>& proven) {
+    const SlotTable slots(program);
+    const vector<int> slotTypes = PredictSlotTypes(program, slots);
+    vector<InstructionHandle>& code = program.GetCode();
+
+    for (int i = 0; i < (int)code.size(); i++) {
+        const Operands& v = code[i].GetOperands();
+        const int opcode = code[i].GetOpcode();
+        auto TypeOf = [&](const int& j) {
+            return proven[i][j] != TYPE_ANY ? proven[i][j] : GetOperandType(program, slots, slotTypes, v[j], i);
+        };
+        //Specializes the instruction, unchecked if the types of the operands at index j1 and j2 are proven
+        auto Specialize = [&](const int& type1, const int& type2, const int& j1, const int& j2) {
+            const int specialized = GetSpecializedOpcode(opcode, v[1].GetIndex(), type1, type2);
+            const bool isProven = proven[i][j1] != TYPE_ANY && (j2 == -1 || proven[i][j2] != TYPE_ANY);
+            code[i].SetOpcode(isProven ? GetUncheckedOpcode(specialized) : specialized);
+        };
+
+        switch (opcode) {
+            case OP_IF_COMPARE:
+                Specialize(TypeOf(0), TypeOf(2), 0, 2);
+                break;
+            case OP_MODIFY:
+                if (slots.Find(v[0], i) != -1)
+                    Specialize(TypeOf(0), TypeOf(2), 0, 2);
+                break;
+            case OP_STEP:
+                if (slots.Find(v[0], i) != -1)
+                    Specialize(TypeOf(0), TYPE_UNSEEN, 0, -1);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+//Removes the label entries, which are no-ops, from the instruction stream
+void DropLabels(Program& program) {
+    const vector<InstructionHandle>& code = program.GetCode();
+
+    vector<bool> removed(code.size());
+    for (size_t i = 0; i < code.size(); i++)
+        removed[i] = code[i].GetOpcode() == OP_LABEL;
+    RemoveInstructions(program, removed);
+}
+
+//Replaces the first instruction of common loop sequences by a superinstruction, which executes the whole sequence in one dispatch.
+//The rest of the sequence stays in place, so jumps into it still work. Superinstructions work on ints and keep the operands of the
+//instruction they replaced in front of their own, so they can fall back to that instruction when their type guard fails.
+void FuseInstructions(Program& program) {
+    vector<InstructionHandle>& code = program.GetCode();
+    const int size = (int)code.size();
+
+    //Appends an operand to an instruction and turns it into a superinstruction
+    auto Fuse = [](InstructionHandle& instruction, const int& opcode, const Operand& operand) {
+        Operands operands = instruction.GetOperands();
+        operands.Push(operand);
+        instruction.SetOperands(operands); instruction.SetOpcode(opcode);
+    };
+
+    for (int i = 0; i + 1 < size; i++) {
+        InstructionHandle& head = code[i];
+        const Operands& v = head.GetOperands();
+
+        //Increment and loop back: 'i++; jump: FOR_n;' where the loop starts with 'if: i < x, END_n;' or 'if: i <= x, END_n;'
+        if (GetGenericOpcode(head.GetOpcode()) == OP_STEP && v[1].GetIndex() == INCREMENT && code[i + 1].GetOpcode() == OP_JUMP) {
+            const Operand target = code[i + 1].GetOperands()[0];
+            const InstructionHandle& condition = code[target.GetIndex() + 1];
+            const Operands& c = condition.GetOperands();
+
+            if (GetGenericOpcode(condition.GetOpcode()) == OP_IF_COMPARE && (c[1].GetIndex() == LESS || c[1].GetIndex() == LESS_EQUAL)
+                && IsSameSlot(v[0], c[0])) {
+                // The loop only skips its guard if both the increment and the condition were proven to work on ints
+                const bool isProven = head.GetOpcode() == OP_INC_INT_UNCHECKED
+                    && (condition.GetOpcode() == OP_IF_LT_INT_INT_UNCHECKED || condition.GetOpcode() == OP_IF_LE_INT_INT_UNCHECKED);
+                const int fused = c[1].GetIndex() == LESS ? OP_INC_INT_LOOP_LT : OP_INC_INT_LOOP_LE;
+                Fuse(head, isProven ? GetUncheckedOpcode(fused) : fused, target);
+            }
+            continue;
+        }
+
+        //Divisibility test: 'x = y; x %= z; if: x == 0, END_n;'
+        if (head.GetOpcode() == OP_SET && i + 2 < size && GetGenericOpcode(code[i + 1].GetOpcode()) == OP_MODIFY
+            && GetGenericOpcode(code[i + 2].GetOpcode()) == OP_IF_COMPARE) {
+            const Operands& m = code[i + 1].GetOperands(); const Operands& c = code[i + 2].GetOperands();
+            // The fused instruction reads the divisor before it assigns x, so x cannot be the divisor
+            const bool sameTarget = IsSameSlot(v[0], m[0]) && IsSameSlot(v[0], c[0]) && !IsSameSlot(v[0], m[2]);
+            const bool comparesToZero = m[1].GetIndex() == MODULO && c[1].GetIndex() == EQUAL && c[2].GetKind() == OPERAND_CONSTANT
+                && program.GetConstant(c[2].GetIndex()).GetType() == INT && program.GetConstant(c[2].GetIndex()).GetInt() == 0;
+
+            if (sameTarget && comparesToZero) {
+                Fuse(head, OP_SET_MOD_IF_ZERO, m[2]);
+                Fuse(head, OP_SET_MOD_IF_ZERO, c[3]);
+            }
+        }
+    }
+}
+
+//Prints every instruction with its index, line, opcode and operands, for --dump-ir
+void DumpProgram(Program& program, std::ostream& out, const string& title) {
+    const vector<InstructionHandle>& code = program.GetCode();
+    const vector<FunctionScope>& functions = program.GetFunctions();
+
+    out << "; " << title << ", " << code.size() << " instructions\n";
+    for (int i = 0; i < (int)code.size(); i++) {
+        //Locals are named after the function the instruction is in
+        int function = -1;
+        for (int f = 0; f < (int)functions.size(); f++)
+            if (i >= functions[f].GetBegin() && i < functions[f].GetEnd())
+                function = f;
+
+        const Operands& v = code[i].GetOperands();
+        out << std::setw(5) << i << "  line " << std::setw(4) << std::left << code[i].GetLine() << "  " << std::setw(26) << IntToOpcode(code[i].GetOpcode()) << std::right;
+        if (code[i].GetOpcode() == OP_LABEL)
+            out << program.GetLabelName(i);
+        for (int j = 0; j < v.Size(); j++)
+            out << (j == 0 ? "" : ", ") << program.OperandToString(v[j], function);
+        out << '\n';
+    }
+    out << std::endl;
+}
+
+#endif // !OPTIMIZE_H
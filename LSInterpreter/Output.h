@@ -0,0 +1,127 @@
+#pragma once
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <vector>
+#include "Archetypes.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <io.h>
+#endif
+
+using std::vector;
+
+// Output of the programs the interpreter runs. Printed values are formatted straight into a buffer, which is written to
+// stdout in large blocks rather than for every value. When it is written depends on the flush policy. It is always written by
+// the flush instruction, before reading input and before the program exits.
+
+enum FlushPolicies {
+    //Written once the buffer is full
+    FLUSH_BLOCK,
+    //Also written at the end of every line
+    FLUSH_LINE,
+    //Written as soon as anything is printed
+    FLUSH_ALWAYS
+};
+
+//Returns: Whether stdout is a terminal, which is where output is expected line by line
+bool IsTerminal() {
+#if defined(__unix__) || defined(__APPLE__)
+    return isatty(fileno(stdout)) != 0;
+#elif defined(_WIN32)
+    return _isatty(_fileno(stdout)) != 0;
+#else
+    return false;
+#endif
+}
+
+//Returns: The text print shows for a value. Numbers are formatted into digits, like cout formats them
+std::string_view FormatValue(const Var& var1, char (&digits)[32]) {
+    switch (var1.GetType()) {
+        case STRING: return var1.GetString();
+        case DOUBLE: return std::string_view(digits, std::to_chars(digits, digits + sizeof(digits), var1.GetDouble(), std::chars_format::general, 6).ptr - digits);
+        case INT: return std::string_view(digits, std::to_chars(digits, digits + sizeof(digits), var1.GetInt()).ptr - digits);
+        case BOOL: return var1.GetBool() ? "true" : "false";
+        default: return std::string_view();
+    }
+}
+
+class Output {
+public:
+    static constexpr size_t BUFFER_SIZE = 1 << 16;
+
+    Output() : buffer_(BUFFER_SIZE), size_(0), policy_(IsTerminal() ? FLUSH_LINE : FLUSH_BLOCK) {}
+
+    ~Output() {
+        Flush();
+    }
+
+    void SetPolicy(const int& policy) {
+        policy_ = policy;
+    }
+
+    void Write(const std::string_view text) {
+        if (text.size() > BUFFER_SIZE - size_) {
+            Flush();
+            //Text that does not fit at all is written on its own
+            if (text.size() >= BUFFER_SIZE) {
+                std::fwrite(text.data(), 1, text.size(), stdout);
+                LS_STAT(GetStats().outputBytes += text.size());
+                return;
+            }
+        }
+        std::memcpy(buffer_.data() + size_, text.data(), text.size());
+        size_ += text.size();
+
+        if (policy_ == FLUSH_ALWAYS || (policy_ == FLUSH_LINE && text.find('\n') != std::string_view::npos))
+            Flush();
+    }
+
+    void Write(const char& c) {
+        Write(std::string_view(&c, 1));
+    }
+
+    void Write(const int& value) {
+        char digits[16];
+        Write(std::string_view(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr - digits));
+    }
+
+    //Doubles are written like cout writes them: in general format with 6 significant digits
+    void Write(const double& value) {
+        char digits[32];
+        Write(std::string_view(digits, std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::general, 6).ptr - digits));
+    }
+
+    //Writes a value the way print shows it
+    void Print(const Var& var1) {
+        char digits[32];
+        Write(FormatValue(var1, digits));
+    }
+
+    //Writes the buffer to stdout
+    void Flush() {
+        if (size_ != 0)
+            std::fwrite(buffer_.data(), 1, size_, stdout);
+        std::fflush(stdout);
+        LS_STAT(GetStats().outputBytes += size_; GetStats().outputFlushes++);
+        size_ = 0;
+    }
+
+private:
+    vector<char> buffer_; size_t size_;
+    int policy_;
+};
+
+//Returns: The output every print goes through
+Output& StandardOutput() {
+    static Output output;
+    return output;
+}
+
+#endif // !OUTPUT_H
@@ -3,24 +3,31 @@
 #define PARSE_H
 
 #include <unordered_set>
+#include <stdexcept>
 #include <functional>
 #include <algorithm>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
+#include "Grammar.h"
 
 using std::vector; using std::string; using std::to_string;
 
-//Returns: Trimmed string | Trims trailing and leading whitespace from string
-string TrimWhitespace(const string& line)
+//Returns: Trimmed view | Trims trailing and leading whitespace from a view, without copying it
+std::string_view TrimWhitespace(const std::string_view line)
 {
-    if (line.empty()) return line;
-
-    const string tags = " \t\v\r\n";
+    const std::string_view tags = " \t\v\r\n";
     size_t start = line.find_first_not_of(tags);
-    if (start == string::npos) return "";
+    if (start == std::string_view::npos) return std::string_view();
     size_t end = line.find_last_not_of(tags);
-    return (start == end) ? line.substr(start, 1) : line.substr(start, end - start + 1);
+    return line.substr(start, end - start + 1);
+}
+
+//Returns: Trimmed string | Trims trailing and leading whitespace from string
+string TrimWhitespace(const string& line)
+{
+    return string(TrimWhitespace(std::string_view(line)));
 }
 
 vector<string> SplitString(const string& s, const char& delimiter) {
@@ -33,97 +40,121 @@ vector<string> SplitString(const string& s, const char& delimiter) {
     }
 
     //Remove any lines that are whitespace
-    for (int i = 0; i < ret.size(); i++)
-        if (TrimWhitespace(ret[i]).empty())
-            ret.erase(ret.begin() + i);
+    ret.erase(std::remove_if(ret.begin(), ret.end(), [](const string& s) { return TrimWhitespace(std::string_view(s)).empty(); }), ret.end());
     return ret;
 }
 
-//Returns: Parsed line vector | Parse a line, making sure ; equals a new line, while checking if it isn't within quotes or in a comment. 
-vector<string> Parse(const string& line) {
-    vector<string> ret(1, string()); bool isString = false, isComment = false; int index = 0;
-    for (const char& c : line) {
-        ++index;
+//Parse a line into statements, making sure ; equals a new line, while checking if it isn't within quotes or in a comment.
+//Ret is cleared first, so one vector can be reused for every line. The statements are views into line, which must outlive them
+void Parse(const std::string_view line, vector<std::string_view>& ret) {
+    ret.clear(); bool isString = false; size_t start = 0, end = line.size();
+    for (size_t i = 0; i < line.size(); i++) {
+        const char c = line[i];
 
         //Anything after comment tag is ignored
-        if (c == '#' && !isString)
-            isComment = true;
-
-        if (isComment)
-            continue;
+        if (c == '#' && !isString) {
+            end = i; break;
+        }
 
         if (c == '"')
             isString = !isString;
 
-        if (c == ';' && !isString && index != line.size()) {
-            ret.back() += ';'; //wtf
-            ret.push_back(string()); continue;
+        //Every semicolon ends a statement, which keeps it
+        if (c == ';' && !isString && i + 1 != line.size()) {
+            ret.push_back(line.substr(start, i + 1 - start));
+            start = i + 1;
         }
-
-        ret.back() += c;
     }
+    ret.push_back(line.substr(start, end - start));
 
     //Edge case where whitespace or a comment follows a semicolon
-    if (std::all_of(ret.back().begin(), ret.back().end(), isspace))
+    if (std::all_of(ret.back().begin(), ret.back().end(), [](const char& c) { return isspace((unsigned char)c); }))
         ret.pop_back();
+}
 
+//Returns: Parsed line vector | Parse a line into statements, which are views into line
+vector<std::string_view> Parse(const std::string_view line) {
+    vector<std::string_view> ret;
+    Parse(line, ret);
     return ret;
 }
 
-//Returns: Tokens in line | Split the line based on an arbitrary amount of tokens. 
-vector<string> Tokenize(const string& line) {
-    vector<string> ret(1, string());
-    int index = 0; bool isString = false, isComment = false;
-
-    //Kinda scuffed, as adding a 3-wide seperator would break the algorithm but whatever
-    for (int i = 0; i < line.size(); i++) {
-        char c = line[i]; char c1 = line[i + 1];
+//A token of a line: the separator it is, or ARG, along with its text. The text is a view into the tokenized line
+struct Token {
+    int type; std::string_view text;
+};
+using Tokens = vector<Token>;
+
+//Split the line based on an arbitrary amount of tokens, into tokens. Tokens is cleared first, so one vector can be reused for every line.
+//Every token is a view into line, so no token is ever copied
+void Tokenize(const std::string_view line, Tokens& tokens) {
+    tokens.clear();
+    //The token being read spans line[start, start + length). Type is set once it is known to be a separator
+    size_t start = 0, length = 0; int type = ARG; bool isString = false;
+
+    auto PushToken = [&]() {
+        if (length != 0)
+            tokens.push_back(Token{ type, line.substr(start, length) });
+        length = 0; type = ARG;
+    };
+    auto Append = [&](const size_t& i, const size_t& count) {
+        if (length == 0)
+            start = i;
+        length += count;
+    };
+
+    for (size_t i = 0; i < line.size(); i++) {
+        const char c = line[i];
 
         //Edge case: Semicolons | Make sure semicolons are always the last token in a line
         if (c == ';' && !isString) {
-            if (ret.back().empty())
-                ret.back() += ";";
-            else
-                ret.push_back(";");
+            PushToken(); Append(i, 1); type = SEMICOLON;
             continue;
         }
 
         //Edge case: No spaces between seperators
-        if (separators.find(ret.back()) != separators.cend() && !isString)
-            ret.push_back(string());
+        if (type != ARG && !isString)
+            PushToken();
 
         //Check for string start and end
         if (c == '"') {
-            isString = !isString; ret.back() += "\""; continue;
+            isString = !isString; Append(i, 1); continue;
         }
 
-        //If any whitespace is found, not within a string and the last token is not empty, push a new token
-        if (isspace(c) && !isString) {
-            if (!ret.back().empty()) ret.push_back(string()); continue;
+        //If any whitespace is found, not within a string, the token ends
+        if (isspace((unsigned char)c) && !isString) {
+            PushToken(); continue;
         }
 
-        //If the current and next character form a seperator, push that back, also skip the next char
-        if (separators.find(string(1, c) + c1) != separators.end() && !isString) {
-            if (!ret.back().empty()) ret.push_back(string());
-            ret.back() += (string(1, c) + c1); ++i; continue;
+        if (!isString) {
+            //If the current and next character form a seperator, push that back, also skip the next char
+            const int pairType = i + 1 < line.size() ? ClassifySeparator(c, line[i + 1]) : ARG;
+            if (pairType != ARG) {
+                PushToken(); Append(i, 2); type = pairType; ++i; continue;
+            }
+
+            //If only the current character is a seperator, do the same
+            const int charType = ClassifySeparator(c);
+            if (charType != ARG) {
+                PushToken(); Append(i, 1); type = charType; continue;
+            }
         }
 
-        //If only the current character is a seperator, do the same
-        if (separators.find(string(1, c)) != separators.end() && !isString) {
-            if (!ret.back().empty()) ret.push_back(string());
-        }
-
-        ret.back() += c;
+        Append(i, 1);
     }
 
     //In case a string was started but never ended with a quote.
     if (isString)
         throw std::runtime_error("Missing closing quote");
 
-    if (ret.back() == string())
-        ret.pop_back();
+    PushToken();
+}
 
-    return ret;
+//Returns: Tokens in line | Split the line based on an arbitrary amount of tokens. The tokens are views into line
+Tokens Tokenize(const std::string_view line) {
+    Tokens tokens;
+    Tokenize(line, tokens);
+    return tokens;
 }
 
 // Removes the quotes from a string
@@ -0,0 +1,183 @@
+#pragma once
+#ifndef PROFILE_H
+#define PROFILE_H
+
+// Sampling profiler behind --profile. A timer signal interrupts the program every millisecond of CPU time, or every tick of
+// the system timer if that is longer, and the handler copies the index of the running instruction and the return indices of
+// the calls it is in. Only once the program exits are the samples mapped back to source lines through the instructions and
+// to functions through the ranges of their code.
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LS_PROFILE_SUPPORTED
+#endif
+
+#ifdef LS_PROFILE_SUPPORTED
+#include <sys/time.h>
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Archetypes.h"
+#include "Parse.h"
+
+using std::vector; using std::string;
+
+class Profiler {
+public:
+    static constexpr int INTERVAL_US = 1000;
+    //Ints of sample records kept, about an hour of samples. Pages are only touched once samples reach them
+    static constexpr size_t CAPACITY = 1 << 24;
+    //Calls kept per sample, the innermost ones
+    static constexpr size_t MAX_DEPTH = 256;
+
+    Profiler() : used_(0), sampleCount_(0), dropped_(0), pc_(nullptr), callStack_(nullptr) {}
+
+    //Starts sampling the running instruction pc and the calls on callStack
+    void Start(const int& pc, const vector<Frame>& callStack) {
+        records_.reset(new int[CAPACITY]);
+        pc_ = &pc; callStack_ = &callStack; active_ = this;
+
+        struct sigaction action = {};
+        action.sa_handler = Sample; action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGPROF, &action, nullptr);
+
+        itimerval timer = {};
+        timer.it_interval.tv_usec = timer.it_value.tv_usec = INTERVAL_US;
+        setitimer(ITIMER_PROF, &timer, nullptr);
+    }
+
+    void Stop() {
+        itimerval timer = {};
+        setitimer(ITIMER_PROF, &timer, nullptr);
+        signal(SIGPROF, SIG_IGN);
+    }
+
+    //Writes the samples per source line and per function to out, and the sampled call stacks to folded,
+    //one line of ';' separated functions and a count per stack, the collapsed format flame graph tools read
+    void Report(Program& program, const string& source, std::ostream& out, std::ostream& folded) {
+        const vector<InstructionHandle>& code = program.GetCode();
+        const vector<FunctionScope>& functions = program.GetFunctions();
+
+        //The function whose code holds every instruction, -1 for the top level
+        vector<int> owner(code.size(), -1);
+        for (int f = 0; f < (int)functions.size(); f++)
+            for (int i = std::max(functions[f].GetBegin(), 0); i < functions[f].GetEnd() && i < (int)code.size(); i++)
+                owner[i] = f;
+        auto OwnerOf = [&owner](const int& index) {
+            return index >= 0 && index < (int)owner.size() ? owner[index] : -1;
+        };
+        auto NameOf = [&functions](const int& function) -> string {
+            return function == -1 ? "(top level)" : functions[function].GetName();
+        };
+
+        vector<std::string_view> sourceLines = { std::string_view() };
+        for (size_t begin = 0; begin <= source.size(); ) {
+            size_t end = source.find('\n', begin);
+            if (end == string::npos) end = source.size();
+            sourceLines.push_back(TrimWhitespace(std::string_view(source).substr(begin, end - begin)));
+            begin = end + 1;
+        }
+
+        //Samples of every line, the functions of every line, the samples a function runs itself and the ones it is on the stack for
+        std::map<int, size_t> lineSamples; std::map<int, int> lineOwners;
+        vector<size_t> selfSamples(functions.size() + 1), totalSamples(functions.size() + 1);
+        std::map<string, size_t> stacks; size_t unmapped = 0;
+
+        vector<int> stack;
+        for (size_t at = 0; at < used_; ) {
+            const int depth = records_[at];
+            const int* returns = &records_[at + 1]; const int pc = records_[at + 1 + depth];
+            at += depth + 2;
+
+            if (pc < 0 || pc >= (int)code.size()) {
+                unmapped++; continue;
+            }
+            const int line = code[pc].GetLine();
+            lineSamples[line]++; lineOwners.emplace(line, owner[pc]);
+
+            stack.clear();
+            for (int i = 0; i < depth; i++)
+                stack.push_back(OwnerOf(returns[i]));
+            stack.push_back(owner[pc]);
+
+            selfSamples[owner[pc] + 1]++;
+            vector<int> counted;
+            string collapsed;
+            for (const int& function : stack) {
+                if (std::find(counted.begin(), counted.end(), function) == counted.end()) {
+                    totalSamples[function + 1]++; counted.push_back(function);
+                }
+                collapsed += (collapsed.empty() ? "" : ";") + NameOf(function);
+            }
+            stacks[collapsed]++;
+        }
+
+        auto Percent = [this](const size_t& samples) {
+            char text[16];
+            std::snprintf(text, sizeof(text), "%5.1f%%", sampleCount_ == 0 ? 0.0 : 100.0 * samples / sampleCount_);
+            return string(text);
+        };
+        auto Pad = [](const string& text, const size_t& width) {
+            return text.size() >= width ? text : string(width - text.size(), ' ') + text;
+        };
+
+        out << "\nProfile: " << sampleCount_ << " samples";
+        if (dropped_ != 0 || unmapped != 0)
+            out << " (" << dropped_ << " dropped, " << unmapped << " outside the program)";
+        out << "\n\nLines by samples\n" << "  samples       %  line  function\n";
+
+        vector<std::pair<int, size_t>> lines(lineSamples.begin(), lineSamples.end());
+        std::stable_sort(lines.begin(), lines.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+        for (const auto& [line, samples] : lines)
+            out << Pad(std::to_string(samples), 9) << "  " << Percent(samples) << Pad(std::to_string(line), 6) << "  "
+                << NameOf(lineOwners[line]) << ": "
+                << (line > 0 && line < (int)sourceLines.size() ? sourceLines[line] : "(added by the compiler)") << "\n";
+
+        out << "\nFunctions by samples\n" << "     self       %     total       %  function\n";
+        vector<int> order;
+        for (int f = -1; f < (int)functions.size(); f++)
+            if (totalSamples[f + 1] != 0)
+                order.push_back(f);
+        std::stable_sort(order.begin(), order.end(), [&selfSamples](const int& a, const int& b) { return selfSamples[a + 1] > selfSamples[b + 1]; });
+        for (const int& f : order)
+            out << Pad(std::to_string(selfSamples[f + 1]), 9) << "  " << Percent(selfSamples[f + 1])
+                << Pad(std::to_string(totalSamples[f + 1]), 10) << "  " << Percent(totalSamples[f + 1]) << "  " << NameOf(f) << "\n";
+
+        for (const auto& [collapsed, samples] : stacks)
+            folded << collapsed << " " << samples << "\n";
+    }
+
+private:
+    //Appends [depth, return indices..., pc] to the records. Only copies ints, as anything else is unsafe in a signal handler
+    static void Sample(int) {
+        Profiler& profiler = *active_;
+        profiler.sampleCount_ = profiler.sampleCount_ + 1;
+
+        const Frame* frames = profiler.callStack_->data();
+        const size_t size = profiler.callStack_->size(); const size_t depth = std::min(size, MAX_DEPTH);
+        if (profiler.used_ + depth + 2 > CAPACITY) {
+            profiler.dropped_ = profiler.dropped_ + 1; return;
+        }
+
+        int* record = &profiler.records_[profiler.used_];
+        record[0] = (int)depth;
+        for (size_t i = 0; i < depth; i++)
+            record[1 + i] = frames[size - depth + i].GetReturnIndex();
+        record[1 + depth] = *profiler.pc_;
+        profiler.used_ = profiler.used_ + depth + 2;
+    }
+
+    inline static Profiler* active_ = nullptr;
+
+    std::unique_ptr<int[]> records_; volatile size_t used_, sampleCount_, dropped_;
+    const volatile int* pc_; const vector<Frame>* callStack_;
+};
+
+#endif
+#endif // !PROFILE_H
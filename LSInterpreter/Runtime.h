@@ -0,0 +1,406 @@
+#pragma once
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "Archetypes.h"
+#include "Output.h"
+#include "Input.h"
+#include "Parse.h"
+
+using std::vector; using std::string; using std::runtime_error;
+
+// Runtime of the programs --emit-cpp generates. A generated program keeps its vars in a Runtime and calls it for every
+// instruction but jumps, which become gotos. Errors and output match the interpreter's, which shares the helpers below.
+
+double GenerateRandomDouble() {
+    //Random engine.
+    static std::mt19937 rng(static_cast<unsigned int>(std::chrono::steady_clock::now().time_since_epoch().count()));
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    return dist(rng);
+}
+
+double fast_stod(const string& str) {
+    double value = 0.0;
+    std::from_chars(str.data(), str.data() + str.size(), value);
+    return value;
+}
+
+int fast_stoi(const string& str) {
+    int value = 0;
+    std::from_chars(str.data(), str.data() + str.size(), value);
+    return value;
+}
+
+class Runtime {
+public:
+    //The globals come first in memory, the frames of the running functions are stacked above them
+    Runtime(const int& globalCount, const int& maxFrameSize) : memory(globalCount + maxFrameSize, Var::Undefined()),
+        frameBase(globalCount), frameTop(globalCount), maxFrameSize(maxFrameSize), start(std::chrono::high_resolution_clock::now()) {
+        stack.reserve(128); callStack.reserve(128);
+    }
+
+    //Getters of the globals and the frame of the running function. Both move when a call grows the memory
+    Var* Globals() {
+        return memory.data();
+    }
+
+    Var* Locals() {
+        return memory.data() + frameBase;
+    }
+
+    //Returns: The value of a var read by an instruction
+    const Var& Value(const Var& var, const char* name) const {
+        if (!var.IsDefined())
+            throw runtime_error("Instruction received undefined identifier '" + string(name) + "'");
+        if (var.GetType() == ERROR)
+            throw runtime_error("Instruction received uninitialized variable '" + string(name) + "'");
+        return var;
+    }
+
+    //Returns: The var an instruction writes to. Operands that are no vars are passed as nullptr
+    Var& Find(Var* var, const char* name) const {
+        if (var != nullptr && var->IsDefined())
+            return *var;
+        throw runtime_error("Instruction received undefined identifier '" + string(name) + "'");
+    }
+
+    void Print(const Var& var1) const {
+        StandardOutput().Print(var1);
+    }
+
+    void PrintLine(const Var& var1) const {
+        Print(var1); StandardOutput().Write('\n');
+    }
+
+    void Endl() const {
+        StandardOutput().Write('\n');
+    }
+
+    void Clear() const {
+        StandardOutput().Write("\033[2J\033[1;1H\n"); StandardOutput().Flush();
+    }
+
+    void Flush() const {
+        StandardOutput().Flush();
+    }
+
+    //Reads a line into a var. A line of another type than the var, or the end of the input, sets errorLevel and leaves it as it is
+    void Input(Var& var1) {
+        int type = var1.GetType();
+        errorLevel = 0;
+
+        string s = "";
+        if (!StandardInput().ReadLine(s)) {
+            errorLevel = INPUT_END; return;
+        }
+        int lineType = GetDataType(s);
+        if (lineType == ERROR)
+            lineType = STRING;
+        if (type == ERROR)
+            type = lineType;
+        if (type != lineType && type != STRING) {
+            errorLevel = 1; return;
+        }
+
+        switch (type) {
+            case STRING: var1.SetData(FormatStringA(s)); break;
+            case DOUBLE: var1.SetData(fast_stod(s)); break;
+            case INT: var1.SetData(fast_stoi(s)); break;
+            case BOOL: var1.SetData(s == "true"); break;
+            default: break;
+        }
+    }
+
+    //Reads the next field of the input into a var
+    void Read(Var& var1) {
+        errorLevel = StandardInput().Read(var1);
+    }
+
+    void Push(const Var& var1) {
+        if (var1.GetType() == ERROR)
+            throw runtime_error("Tried pushing uninitialized variable onto stack");
+        stack.emplace_back(var1);
+    }
+
+    //Pops the top of the stack into a var, defining it if needed. Sets errorLevel if the stack is empty
+    void Pop(Var* var1, const char* name) {
+        errorLevel = 0;
+        if (stack.empty()) {
+            errorLevel = 1; return;
+        }
+        if (var1 == nullptr)
+            throw runtime_error("Pop received invalid identifier '" + string(name) + "'");
+
+        Var top = std::move(stack.back());
+        stack.pop_back();
+        if (!var1->IsDefined()) {
+            *var1 = std::move(top);
+            return;
+        }
+
+        int type = var1->GetType(); const int topType = top.GetType();
+        if (type == ERROR)
+            type = topType;
+        if (type != topType)
+            throw runtime_error("Pop received wrong type Got: '" + IntToType(type) + "' Expected: '" + IntToType(topType));
+        *var1 = std::move(top);
+    }
+
+    void PopClear() {
+        stack.clear();
+    }
+
+    void Declare(Var& var0, const Var& var1, const char* name) {
+        if (var0.IsDefined())
+            throw runtime_error("Variable by the name of '" + string(name) + "' already defined");
+        var0 = var1;
+    }
+
+    void DeclareEmpty(Var& var0, const char* name) {
+        if (var0.IsDefined())
+            throw runtime_error("Variable by the name of '" + string(name) + "' already defined");
+        var0 = Var();
+    }
+
+    //Frees a var. Sets errorLevel if it does not exist
+    void Delete(Var* var1) {
+        errorLevel = 0;
+        if (var1 == nullptr || !var1->IsDefined()) {
+            errorLevel = 1; return;
+        }
+        var1->Release();
+    }
+
+    void Modify(Var& var1, const int& op, const Var& var2) {
+        const int nameType = var1.GetType(), valueType = var2.GetType();
+
+        if (nameType != valueType && !(nameType == DOUBLE && valueType == INT) && !(nameType == INT && valueType == DOUBLE))
+            throw runtime_error("Arithmetic operation received wrong type. Got: '" + IntToType(valueType) + "' Expected: '" + IntToType(nameType) + "'");
+        if (nameType == BOOL)
+            throw runtime_error("Cannot perform arithmetic operation on type 'bool'");
+        if (nameType == STRING && op != ADD)
+            throw runtime_error("Cannot use operator '" + IntToOperator(op) + "' on a string");
+        if (nameType == STRING) {
+            var1.Append(var2.GetString());
+            return;
+        }
+
+        if (nameType == DOUBLE && valueType == DOUBLE)
+            Arithmetic(var1, var1.GetDouble(), var2.GetDouble(), op);
+        else if (nameType == DOUBLE)
+            Arithmetic(var1, var1.GetDouble(), var2.GetInt(), op);
+        else if (valueType == DOUBLE)
+            Arithmetic(var1, var1.GetInt(), var2.GetDouble(), op);
+        else
+            Arithmetic(var1, var1.GetInt(), var2.GetInt(), op);
+    }
+
+    //Appends a value to a string the way print shows it
+    void Append(Var& var1, const Var& var2) const {
+        if (var2.GetType() == ERROR)
+            throw runtime_error("Tried appending uninitialized variable");
+        if (var1.GetType() == ERROR)
+            var1.SetData(std::string_view());
+        else if (var1.GetType() != STRING)
+            throw runtime_error("Append received wrong type. Got: '" + IntToType(var1.GetType()) + "' Expected: 'string'");
+
+        char digits[32];
+        var1.Append(FormatValue(var2, digits));
+    }
+
+    void Step(Var& var1, const int& op) {
+        const int type = var1.GetType();
+        if (op != INCREMENT && op != DECREMENT)
+            throw runtime_error("Wrong operator received. Expected '++' or '--'");
+
+        if (type == DOUBLE)
+            var1.SetData(var1.GetDouble() + (op == INCREMENT ? 1.0 : -1.0));
+        else if (type == INT)
+            var1.SetData(var1.GetInt() + (op == INCREMENT ? 1 : -1));
+        else
+            throw runtime_error("Cannot use operator '" + IntToOperator(op) + "' on type '" + IntToType(type) + "'");
+    }
+
+    void Sqrt(Var& var1) {
+        const int type = var1.GetType();
+        if (type != DOUBLE && type != INT)
+            throw runtime_error("Square root operation received wrong type. Got: '" + IntToType(type) + "'");
+
+        if (type == DOUBLE)
+            var1.SetData(std::sqrt(var1.GetDouble()));
+        else
+            var1.SetData((int)std::sqrt(var1.GetInt()));
+    }
+
+    void Abs(Var& var1) {
+        const int type = var1.GetType();
+        if (type != DOUBLE && type != INT)
+            throw runtime_error("Absolute operation received wrong type. Got: '" + IntToType(type) + "'");
+
+        //A double goes through the int overload of abs, as it does in the interpreter
+        if (type == DOUBLE)
+            var1.SetData(std::abs((int)var1.GetDouble()));
+        else
+            var1.SetData(std::abs(var1.GetInt()));
+    }
+
+    void Rand(Var& var1) {
+        var1.SetData(GenerateRandomDouble());
+    }
+
+    void Millis(Var& var1) {
+        var1.SetData((int)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count());
+    }
+
+    void Seconds(Var& var1) {
+        var1.SetData(std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count());
+    }
+
+    void Delay(const Var& var1) {
+        const int type = var1.GetType();
+        if (type != DOUBLE && type != INT)
+            throw runtime_error("Delay received wrong type. Got: '" + IntToType(type) + "'");
+        std::this_thread::sleep_for(std::chrono::milliseconds(type == DOUBLE ? (int)var1.GetDouble() : var1.GetInt()));
+    }
+
+    //Returns: Whether 'if: var1 op var2' holds
+    bool Compare(const Var& var1, const int& op, const Var& var2) const {
+        const int value1Type = var1.GetType(), value2Type = var2.GetType();
+
+        if (value1Type != value2Type && !(value1Type == DOUBLE && value2Type == INT) && !(value1Type == INT && value2Type == DOUBLE))
+            throw runtime_error("Comparing different types. Type1: '" + IntToType(value1Type) + "' Type2: '" + IntToType(value2Type) + "'");
+        if (op == EQUAL)
+            return var1 == var2;
+        if (op == NOT_EQUAL)
+            return var1 != var2;
+        if (value1Type == STRING || value1Type == BOOL)
+            throw runtime_error("Cannot use relational operators on Type: '" + IntToType(value1Type) + "'");
+
+        const double val1 = (value1Type == DOUBLE) ? var1.GetDouble() : (double)(var1.GetInt());
+        const double val2 = (value2Type == DOUBLE) ? var2.GetDouble() : (double)(var2.GetInt());
+        switch (op) {
+            case LESS: return !(val1 >= val2);
+            case GREATER: return !(val1 <= val2);
+            case LESS_EQUAL: return !(val1 > val2);
+            case GREATER_EQUAL: return !(val1 < val2);
+            default: return true;
+        }
+    }
+
+    //Returns: Whether 'if: var1' holds. It does for anything but false and uninitialized vars
+    bool IsTrue(const Var& var1) const {
+        return !(var1.GetType() == BOOL && !var1.GetBool()) && var1.GetType() != ERROR;
+    }
+
+    //Returns: Whether 'if: !var1' holds. It does for false and uninitialized vars
+    bool IsFalse(const Var& var1) const {
+        return var1.GetType() == BOOL ? !var1.GetBool() : var1.GetType() == ERROR;
+    }
+
+    //Enters a label. A call to a function sets up its frame right above the caller's, where the arguments were already bound
+    void Call(const int& returnIndex, const int& function, const int& frameSize) {
+        callStack.emplace_back(returnIndex, frameBase, frameTop, function);
+        if (function != -1) {
+            frameBase = frameTop; frameTop += frameSize;
+            if ((int)memory.size() < frameTop + maxFrameSize)
+                memory.resize(std::max(memory.size() * 2, (size_t)(frameTop + maxFrameSize)), Var::Undefined());
+        }
+        argCount = 0;
+    }
+
+    void Arg(const Var& value) {
+        if (frameTop + argCount >= (int)memory.size())
+            throw runtime_error("Call received too many arguments");
+        memory[frameTop + argCount++] = value;
+    }
+
+    //Binds the result of a nested call. Sets errorLevel and leaves the parameter undefined if the stack is empty
+    void ArgPop() {
+        errorLevel = 0;
+        if (stack.empty()) {
+            errorLevel = 1; argCount++; return;
+        }
+        Arg(stack.back());
+        stack.pop_back();
+    }
+
+    //Frees the frame of the returning function. Returning outside of any call ends the program.
+    //Returns: The index of the call returned from
+    int Return() {
+        if (callStack.empty())
+            Exit(0);
+
+        const Frame& caller = callStack.back();
+        if (caller.GetTop() == frameBase)
+            for (int i = frameBase; i < frameTop; i++)
+                memory[i].Release();
+
+        const int returnIndex = caller.GetReturnIndex(); frameBase = caller.GetBase(); frameTop = caller.GetTop();
+        callStack.pop_back();
+        return returnIndex;
+    }
+
+    void ExitWith(const Var& var1) const {
+        if (var1.GetType() != INT)
+            throw runtime_error("Exit requires argument type: 'int' got: '" + IntToType(var1.GetType()) + "'");
+        Exit(var1.GetInt());
+    }
+
+    // Prints the exit message and terminates the program
+    [[noreturn]] void Exit(const int& code) const {
+        StandardOutput().Write("\nProgram sucessfully executed. Exited with code " + std::to_string(code) + ".\nElapsed time: "
+            + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count()) + " ms\n");
+        StandardOutput().Flush();
+        exit(code);
+    }
+
+    //Reports an error of the instruction on the current line, like the interpreter does
+    [[noreturn]] void ExitError(const string& error) const {
+        StandardOutput().Flush();
+        std::cerr << '\n' << error << " on line " << std::to_string(line) << "." << std::endl;
+        exit(-1);
+    }
+
+    vector<Var> memory, stack; vector<Frame> callStack;
+    int frameBase, frameTop, maxFrameSize, argCount = 0, errorLevel = 0, line = 0;
+
+private:
+    template<typename T1, typename T2>
+    static void Arithmetic(Var& var1, const T1& val1, const T2& val2, const int& op) {
+        switch (op) {
+            case ADD: var1.SetData(val1 + val2); break;
+            case SUBTRACT: var1.SetData(val1 - val2); break;
+            case MULTIPLY: var1.SetData(val1 * val2); break;
+            case DIVIDE:
+                if (val2 == 0.0)
+                    throw runtime_error("Division by 0 attempted");
+                var1.SetData(val1 / val2);
+                break;
+            case MODULO:
+                if constexpr (std::is_integral_v<T1> && std::is_integral_v<T2>) {
+                    if (val2 == 0)
+                        throw runtime_error("Modulo by 0 attempted");
+                    var1.SetData(val1 % val2);
+                }
+                else
+                    throw runtime_error("Modulo operation is only valid for integral types");
+                break;
+            default: break;
+        }
+    }
+
+    std::chrono::high_resolution_clock::time_point start;
+};
+
+#endif // !RUNTIME_H
@@ -0,0 +1,55 @@
+#pragma once
+#ifndef STATS_H
+#define STATS_H
+
+// Execution statistics behind --stats, in builds made with LS_STATS defined. They tell whether a script spends its time
+// dispatching instructions, on memory, on calls or on input and output. Without LS_STATS every counter and hook is compiled out.
+
+#ifdef LS_STATS
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+//Phases of a run whose time is measured
+enum StatPhases {
+    //Loading the compiled program from the .lsc cache
+    PHASE_LOAD,
+    //Lexing, parsing and lowering the source
+    PHASE_PARSE,
+    PHASE_LABELS,
+    //Resolving and compiling the instructions, and the passes after
+    PHASE_COMPILE,
+    PHASE_EXECUTE,
+    PHASE_COUNT
+};
+
+struct Stats {
+    //Times the instruction at every index was dispatched. Sized once the program is final
+    vector<uint64_t> executed;
+    size_t maxStack = 0, maxCallDepth = 0;
+    uint64_t stringAllocations = 0, outputBytes = 0, outputFlushes = 0, inputBytes = 0, inputReads = 0;
+    double phaseMs[PHASE_COUNT] = {};
+};
+
+//Returns: The statistics of the running program
+Stats& GetStats() {
+    static Stats stats;
+    return stats;
+}
+
+//Adds the time since start to a phase, and starts timing the next one
+void EndPhase(const int& phase, std::chrono::high_resolution_clock::time_point& start) {
+    const auto now = std::chrono::high_resolution_clock::now();
+    GetStats().phaseMs[phase] += std::chrono::duration<double, std::milli>(now - start).count();
+    start = now;
+}
+
+//Runs a statement only in builds with statistics
+#define LS_STAT(statement) statement
+#else
+#define LS_STAT(statement)
+#endif
+
+#endif // !STATS_H
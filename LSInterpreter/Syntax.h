@@ -0,0 +1,671 @@
+#pragma once
+#ifndef SYNTAX_H
+#define SYNTAX_H
+
+#include <algorithm>
+#include <deque>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Archetypes.h"
+#include "Jobs.h"
+#include "Parse.h"
+
+using std::vector; using std::string; using std::to_string;
+
+// The front end: the source is lexed into statements, parsed into a syntax tree and lowered into a flat list of labels and
+// instructions. Control structures are lowered straight from the tree, so no source text is generated or tokenized again.
+
+//An error in the script, along with the line it is on
+class SyntaxError : public std::runtime_error {
+public:
+    SyntaxError(const string& error, const int& line) : std::runtime_error(error), line_(line) {}
+
+    int GetLine() const {
+        return line_;
+    }
+
+private:
+    int line_;
+};
+
+//A statement of the source, split into tokens. Its text and tokens are views into the source
+struct SourceStatement {
+    int line; std::string_view text; Tokens tokens;
+};
+
+//Lexes the lines of source, the first of which is line firstLine, appending their statements
+void LexLines(const std::string_view source, const int& firstLine, vector<SourceStatement>& statements) {
+    vector<std::string_view> parsed; int lineNum = firstLine - 1;
+    for (size_t begin = 0; begin < source.size(); ) {
+        size_t end = source.find('\n', begin);
+        if (end == std::string_view::npos) end = source.size();
+
+        ++lineNum;
+        const std::string_view line = TrimWhitespace(source.substr(begin, end - begin));
+        begin = end + 1;
+        if (line.empty()) continue;
+
+        Parse(line, parsed);
+        for (const std::string_view& statement : parsed) {
+            //After seperating semicolons, trim them to get rid of any whitespace inbetween.
+            SourceStatement lexed{ lineNum, TrimWhitespace(statement), Tokens() };
+            try {
+                Tokenize(lexed.text, lexed.tokens);
+            }
+            catch (const std::runtime_error& e) {
+                throw SyntaxError(e.what(), lineNum);
+            }
+            if (!lexed.tokens.empty())
+                statements.push_back(std::move(lexed));
+        }
+    }
+}
+
+//Returns: Every statement of the source in order. Whitespace, empty lines and comments are skipped.
+//Lines are lexed on their own, so large sources are split into chunks of whole lines which are lexed by jobs in parallel
+vector<SourceStatement> LexSource(const std::string_view source, const int& jobs = 1) {
+    const int chunkCount = CountJobs(jobs, source.size(), 1 << 16);
+
+    //Chunks start after the line break nearest to an even split, along with the number of the line they start on
+    vector<size_t> chunkBegins{ 0 }; vector<int> chunkLines{ 1 };
+    for (int chunk = 1; chunk < chunkCount; chunk++) {
+        const size_t split = source.find('\n', std::max(source.size() * chunk / chunkCount, chunkBegins.back()));
+        const size_t begin = split == std::string_view::npos ? source.size() : split + 1;
+        chunkLines.push_back(chunkLines.back() + (int)std::count(source.begin() + chunkBegins.back(), source.begin() + begin, '\n'));
+        chunkBegins.push_back(begin);
+    }
+    chunkBegins.push_back(source.size());
+
+    vector<vector<SourceStatement>> chunks(chunkCount);
+    RunJobs(chunkCount, [&](const int& chunk) {
+        LexLines(source.substr(chunkBegins[chunk], chunkBegins[chunk + 1] - chunkBegins[chunk]), chunkLines[chunk], chunks[chunk]);
+    });
+
+    if (chunkCount == 1)
+        return std::move(chunks[0]);
+    size_t statementCount = 0;
+    for (const vector<SourceStatement>& chunk : chunks)
+        statementCount += chunk.size();
+    vector<SourceStatement> statements; statements.reserve(statementCount);
+    for (vector<SourceStatement>& chunk : chunks)
+        statements.insert(statements.end(), std::make_move_iterator(chunk.begin()), std::make_move_iterator(chunk.end()));
+    return statements;
+}
+
+enum NodeKinds {
+    NODE_INSTRUCTION,
+    NODE_LABEL,
+    NODE_CALL,
+    NODE_IF,
+    NODE_FOR,
+    NODE_WHILE,
+    NODE_FUNC,
+    NODE_BREAK,
+    NODE_CONTINUE,
+    NODE_RETURN
+};
+
+//A call of a function. Its arguments are either tokens, or calls whose results are passed on
+struct CallNode {
+    std::string_view name; bool isCall = false;
+    vector<CallNode> args;
+};
+
+//Tokens of a node, viewed in the statement it was parsed from
+using TokenSpan = std::span<const Token>;
+
+struct Node;
+
+//The parts of a node only blocks and calls have. Most nodes are instructions, so they are kept apart to keep nodes small
+struct NodeBlock {
+    //For: the declaration 'variable = value', if any, and the step
+    TokenSpan init, step;
+    //Functions: their parameters. Calls: the call
+    vector<string> params; CallNode call;
+    //An if only has an else if elseLine is set. The line a block ends on is used for what is lowered at its end
+    vector<Node> body, elseBody;
+    int elseLine = 0, elseId = 0, endLine = 0;
+    //Loops: whether a continue jumps to their end
+    bool hasContinue = false;
+};
+
+//A node of the syntax tree. Id is the index of the statement it was parsed from, which keeps the labels it is lowered to unique
+struct Node {
+    int kind = NODE_INSTRUCTION, line = 0, id = 0;
+    //Break and continue: id of the loop they belong to
+    int target = 0;
+    //Instructions: their tokens. If, for and while: their condition. Return: the value returned, if any
+    TokenSpan tokens;
+    //Labels and functions: their name. Calls: the variable their result is popped to, if any
+    std::string_view name;
+    std::unique_ptr<NodeBlock> block;
+};
+
+//Parses lexed statements into a syntax tree by recursive descent. Blocks are opened with '{' or ':' and closed with '}' or 'end;'.
+//The tree views the tokens of the statements, so they have to outlive it
+class Parser {
+public:
+    Parser(const vector<SourceStatement>& statements) : statements_(statements), position_(0) {}
+
+    //Returns: The nodes of the whole program
+    vector<Node> ParseProgram() {
+        vector<Node> nodes;
+        ParseBlock(nodes);
+        return nodes;
+    }
+
+private:
+    //How a block ended
+    enum BlockEnds { BLOCK_CLOSED, BLOCK_ELSE, BLOCK_EOF };
+
+    //A block that is still open, innermost last
+    struct OpenBlock {
+        int kind, line, id; bool hasContinue;
+    };
+
+    //Parses statements into nodes until the innermost open block ends. Returns: How it ended
+    int ParseBlock(vector<Node>& nodes) {
+        while (position_ < statements_.size()) {
+            const SourceStatement& statement = statements_[position_]; const int id = (int)++position_;
+            const Tokens& tokens = statement.tokens; const std::string_view name = tokens[0].text;
+
+            if (name == "}" || name == "end") {
+                if (tokens.size() != (name == "}" ? 1u : 2u) || (name == "end" && tokens[1].type != SEMICOLON))
+                    throw SyntaxError(string(name) + " received wrong implementation", statement.line);
+                if (open_.empty())
+                    throw SyntaxError("Received hanging closing curly bracket", statement.line);
+                return BLOCK_CLOSED;
+            }
+            if (name == "else") {
+                if (tokens.size() != 2 || (tokens[1].type != O_CURLY && tokens[1].type != COLON))
+                    throw SyntaxError("else received wrong implementation", statement.line);
+                if (open_.empty())
+                    throw SyntaxError("Hanging else-statement received", statement.line);
+                if (open_.back().kind != NODE_IF)
+                    throw SyntaxError("Else-statement can only be within an if-statement", statement.line);
+                return BLOCK_ELSE;
+            }
+
+            if (name == "if" || name == "while" || name == "for")
+                nodes.push_back(ParseControl(statement, id));
+            else if (name == "break" || name == "continue")
+                nodes.push_back(ParseJump(statement, id));
+            else if (name == "return")
+                nodes.push_back(ParseReturn(statement, id));
+            else if (name == "func")
+                nodes.push_back(ParseFunction(statement, id));
+            else if (functions_.find(name) != functions_.cend())
+                nodes.push_back(ParseCallStatement(statement, id));
+            else
+                nodes.push_back(ParseInstruction(statement, id));
+        }
+
+        //If any statements are still open, no end was received.
+        if (!open_.empty())
+            throw SyntaxError("If-statement did not receive end", open_.front().line);
+        return BLOCK_EOF;
+    }
+
+    //Parses the body of a block opened by node, up to its end. An if continues into its else block
+    void ParseBody(Node& node) {
+        NodeBlock& block = *node.block;
+        open_.push_back(OpenBlock{ node.kind, node.line, node.id, false });
+        int end = ParseBlock(block.body);
+        if (end == BLOCK_ELSE) {
+            const SourceStatement& statement = statements_[position_ - 1];
+            block.elseLine = statement.line; block.elseId = (int)position_;
+            //Else blocks cannot have another else
+            open_.back().kind = -1;
+            end = ParseBlock(block.elseBody);
+        }
+        block.endLine = statements_[position_ - 1].line;
+        block.hasContinue = open_.back().hasContinue;
+        open_.pop_back();
+    }
+
+    //Parses if, while and for statements. Their header is in parentheses followed by '{', or without them followed by ':'
+    Node ParseControl(const SourceStatement& statement, const int& id) {
+        const Tokens& tokens = statement.tokens; const std::string_view name = tokens[0].text;
+        Node node; node.line = statement.line; node.id = id; node.block = std::make_unique<NodeBlock>();
+        node.kind = name == "if" ? NODE_IF : name == "while" ? NODE_WHILE : NODE_FOR;
+
+        auto WrongImplementation = [&]() {
+            return SyntaxError(string(name) + " received wrong implementation", statement.line);
+        };
+
+        size_t i = 1;
+        //Returns: Whether the next token has a type, taking it if so
+        auto Accept = [&](const int& type) {
+            if (i >= tokens.size() || tokens[i].type != type)
+                return false;
+            i++; return true;
+        };
+        auto Expect = [&](const int& type) {
+            if (!Accept(type))
+                throw WrongImplementation();
+        };
+        //Returns: The tokens taken since begin
+        auto Taken = [&](const size_t& begin) {
+            return TokenSpan(tokens).subspan(begin, i - begin);
+        };
+
+        const bool hasParentheses = Accept(O_PAREN);
+
+        if (node.kind == NODE_FOR && i + 1 < tokens.size() && tokens[i + 1].type == SET) {
+            const size_t init = i;
+            Expect(ARG); Expect(SET); Expect(ARG);
+            node.block->init = Taken(init);
+            Expect(COMMA);
+        }
+
+        //Conditions compare two values. An if can also check a bool, or its negation
+        const size_t condition = i;
+        if (node.kind == NODE_IF && Accept(NEG))
+            Expect(ARG);
+        else {
+            Expect(ARG);
+            if (!Accept(LOGIC)) {
+                if (node.kind != NODE_IF)
+                    throw WrongImplementation();
+            }
+            else
+                Expect(ARG);
+        }
+        node.tokens = Taken(condition);
+
+        if (node.kind == NODE_FOR) {
+            Expect(COMMA);
+            const size_t step = i;
+            Expect(ARG); Expect(MOD); Accept(ARG);
+            node.block->step = Taken(step);
+        }
+
+        if (hasParentheses) {
+            Expect(C_PAREN); Expect(O_CURLY);
+        }
+        else
+            Expect(COLON);
+        if (i != tokens.size())
+            throw WrongImplementation();
+
+        ParseBody(node);
+        return node;
+    }
+
+    //Parses break and continue, which jump to the end or the step of the innermost loop
+    Node ParseJump(const SourceStatement& statement, const int& id) {
+        const std::string_view name = statement.tokens[0].text;
+        if (statement.tokens.size() != 2 || statement.tokens[1].type != SEMICOLON)
+            throw SyntaxError(string(name) + " received wrong implementation", statement.line);
+
+        Node node; node.line = statement.line; node.id = id;
+        node.kind = name == "break" ? NODE_BREAK : NODE_CONTINUE;
+        for (auto block = open_.rbegin(); block != open_.rend(); ++block) {
+            if (block->kind != NODE_FOR && block->kind != NODE_WHILE)
+                continue;
+            node.target = block->id;
+            if (node.kind == NODE_CONTINUE)
+                block->hasContinue = true;
+            return node;
+        }
+        throw SyntaxError("A " + string(name) + "-statement can only be used within a loop", statement.line);
+    }
+
+    //Parses return, with or without a value. Outside of a function, return ends the program just like the instruction does
+    Node ParseReturn(const SourceStatement& statement, const int& id) {
+        const Tokens& tokens = statement.tokens;
+        Node node; node.kind = NODE_RETURN; node.line = statement.line; node.id = id;
+
+        if (tokens.size() == 2 && tokens[1].type == SEMICOLON)
+            return node;
+        if (tokens.size() != 4 || tokens[1].type != COLON || tokens[2].type != ARG || tokens[3].type != SEMICOLON)
+            throw SyntaxError("return received wrong implementation", statement.line);
+
+        auto function = std::find_if(open_.cbegin(), open_.cend(), [](const OpenBlock& block) { return block.kind == NODE_FUNC; });
+        if (function == open_.cend())
+            throw SyntaxError("A return-statement can only be used within a function", statement.line);
+
+        node.tokens = TokenSpan(tokens).subspan(2, 1);
+        return node;
+    }
+
+    //Parses a function definition: 'func name(parameters) {' or 'func name(parameters):'
+    Node ParseFunction(const SourceStatement& statement, const int& id) {
+        const Tokens& tokens = statement.tokens; const int lineNum = statement.line;
+
+        //Function should always have at least 5 tokens
+        if (tokens.size() < 5)
+            throw SyntaxError("Invalid args in function definition", lineNum);
+
+        if (tokens.back().type != O_CURLY && tokens.back().type != COLON)
+            throw SyntaxError("Expected '{' or ':' after function definition", lineNum);
+
+        if (!open_.empty())
+            throw SyntaxError("Cannot define a function within another", lineNum);
+
+        //2nd index should always be a open bracket, 2nd to last index should always be a closing bracket
+        if (tokens[2].type != O_PAREN)
+            throw SyntaxError("Expected '(' in function definition", lineNum);
+        if (tokens[tokens.size() - 2].type != C_PAREN)
+            throw SyntaxError("Expected ')' in function definition", lineNum);
+
+        Node node; node.kind = NODE_FUNC; node.line = lineNum; node.id = id; node.name = tokens[1].text;
+        node.block = std::make_unique<NodeBlock>();
+        vector<string>& params = node.block->params;
+
+        //Parameters are separated by commas
+        for (size_t i = 3; i < tokens.size() - 2; i++) {
+            const bool expectsParam = (i - 3) % 2 == 0;
+            if (expectsParam && tokens[i].type == ARG)
+                params.push_back(string(tokens[i].text));
+            else if (expectsParam || tokens[i].type != COMMA)
+                throw SyntaxError(tokens[i].type == COMMA ? "Expected argument got ','" : "Expected ',' in function argument definition", lineNum);
+        }
+        if (tokens.size() > 5 && tokens[tokens.size() - 3].type == COMMA)
+            throw SyntaxError("Expected argument got ','", lineNum);
+
+        //The function can be called from its own body onwards. The first definition of a name decides its parameter count
+        functions_.emplace(string(node.name), (int)params.size());
+        ParseBody(node);
+        return node;
+    }
+
+    //Parses a call of a function, whose arguments can be calls themselves. Position is at the name of the function
+    CallNode ParseCall(const SourceStatement& statement, size_t& position) {
+        const Tokens& tokens = statement.tokens;
+        CallNode call; call.name = tokens[position].text; call.isCall = true;
+
+        if (position + 1 >= tokens.size() || tokens[position + 1].type != O_PAREN)
+            throw SyntaxError("Expected '(' when calling function", statement.line);
+        position += 2;
+
+        //Arguments are separated by commas, up to the closing parenthesis
+        if (position < tokens.size() && tokens[position].type == C_PAREN)
+            position++;
+        else {
+            while (true) {
+                call.args.push_back(ParseArgument(statement, position));
+                if (position >= tokens.size())
+                    throw SyntaxError("Expected ')' when calling function", statement.line);
+
+                const Token& token = tokens[position++];
+                if (token.type == C_PAREN)
+                    break;
+                if (token.type != COMMA)
+                    throw SyntaxError("Expected: ',' Got '" + string(token.text) + "' when calling function", statement.line);
+            }
+        }
+
+        const int paramCount = functions_.find(call.name)->second;
+        if (paramCount != (int)call.args.size())
+            throw SyntaxError("No instance of " + string(call.name) + " takes " + to_string(call.args.size()) + " arguments", statement.line);
+        return call;
+    }
+
+    //Parses an argument of a call: a call of a function, or a value
+    CallNode ParseArgument(const SourceStatement& statement, size_t& position) {
+        if (position >= statement.tokens.size())
+            throw SyntaxError("Expected ')' when calling function", statement.line);
+
+        const Token& token = statement.tokens[position];
+        if (token.type == ARG && functions_.find(token.text) != functions_.cend())
+            return ParseCall(statement, position);
+
+        //Arguments only come after '(' or ','
+        if (token.type == COMMA || token.type == C_PAREN)
+            throw SyntaxError("Expected argument got ','", statement.line);
+        if (token.type == O_PAREN)
+            throw SyntaxError("Hanging '(' received in function call", statement.line);
+        if (token.type != ARG)
+            throw SyntaxError("Expected: ',' Got '" + string(token.text) + "' when calling function", statement.line);
+
+        CallNode value; value.name = token.text;
+        position++;
+        return value;
+    }
+
+    //Parses a call statement: 'name(arguments);', or 'name(arguments) >> variable;' to keep the result
+    Node ParseCallStatement(const SourceStatement& statement, const int& id) {
+        const Tokens& tokens = statement.tokens;
+        if (tokens.size() < 4)
+            throw SyntaxError("Invalid args provided when calling function", statement.line);
+        if (tokens.back().type != SEMICOLON)
+            throw SyntaxError("Expected ';' after calling function", statement.line);
+
+        Node node; node.kind = NODE_CALL; node.line = statement.line; node.id = id; node.block = std::make_unique<NodeBlock>();
+        size_t position = 0;
+        node.block->call = ParseCall(statement, position);
+
+        if (tokens[position].type == RSHIFT) {
+            if (position + 3 != tokens.size() || tokens[position + 1].type != ARG)
+                throw SyntaxError("Invalid args provided when calling function", statement.line);
+            node.name = tokens[position + 1].text;
+        }
+        else if (position + 1 != tokens.size())
+            throw SyntaxError("Expected end of function call, got '" + string(tokens[position].text) + "'", statement.line);
+        return node;
+    }
+
+    //Parses labels and instructions. Which instruction a statement calls is resolved once it is compiled
+    Node ParseInstruction(const SourceStatement& statement, const int& id) {
+        const std::string_view text = statement.text;
+        Node node; node.line = statement.line; node.id = id;
+
+        if (text[0] == '=') {
+            if (text.back() != ';')
+                throw SyntaxError("Expected semicolon on label initialization. Got: '" + string(text) + "'", statement.line);
+            const string label = FormatLabel(string(text));
+            if (label == string())
+                throw SyntaxError("Incorrect label initialization. Got: '" + string(text) + "'", statement.line);
+
+            node.kind = NODE_LABEL; node.name = text.substr(1, text.size() - 2);
+            return node;
+        }
+
+        //Check if semicolon is found
+        if (text.back() != ';')
+            throw SyntaxError("Missing semicolon", statement.line);
+
+        node.kind = NODE_INSTRUCTION; node.tokens = statement.tokens;
+        return node;
+    }
+
+    const vector<SourceStatement>& statements_; size_t position_;
+    vector<OpenBlock> open_;
+    //Parameter count of every function defined so far
+    NameMap<int> functions_;
+};
+
+//A statement lowered from the syntax tree: a label, or an instruction along with the tokens of its arguments.
+//Instructions named by an identifier rather than an instruction are resolved when they are compiled
+struct LoweredStatement {
+    int line; bool isLabel;
+    std::string_view name; int first, count;
+};
+
+//The lowered program. Statements view their tokens in tokens, and their names in the source or in names
+struct LoweredProgram {
+    vector<LoweredStatement> statements;
+    vector<Token> tokens;
+    //Names of generated labels. A deque never moves its strings, so views of them stay valid
+    std::deque<string> names;
+
+    TokenSpan GetTokens(const LoweredStatement& statement) const {
+        return TokenSpan(tokens).subspan(statement.first, statement.count);
+    }
+};
+
+//Lowers the syntax tree into labels and instructions, in the order they run. Functions are registered with the program,
+//at the index their label is lowered to
+class Lowering {
+public:
+    Lowering(Program& program) : program_(program) {}
+
+    //Returns: The lowered program. It views the source, so the source has to outlive it
+    LoweredProgram Lower(const vector<Node>& nodes) {
+        for (const Node& node : nodes)
+            LowerNode(node);
+        return std::move(lowered_);
+    }
+
+private:
+    //Generated labels are named after the statement they were generated for
+    std::string_view LabelName(const string& prefix, const int& id) {
+        return lowered_.names.emplace_back(prefix + "_" + to_string(id));
+    }
+
+    void Label(const int& line, const std::string_view name) {
+        lowered_.statements.push_back(LoweredStatement{ line, true, name, 0, 0 });
+    }
+
+    //Lowers an instruction along with its tokens
+    void Emit(const int& line, const std::string_view name, const Token* begin, const Token* end) {
+        lowered_.statements.push_back(LoweredStatement{ line, false, name, (int)lowered_.tokens.size(), (int)(end - begin) });
+        lowered_.tokens.insert(lowered_.tokens.end(), begin, end);
+    }
+
+    void Emit(const int& line, const std::string_view name, const std::initializer_list<Token> tokens) {
+        Emit(line, name, tokens.begin(), tokens.end());
+    }
+
+    void Emit(const int& line, const std::string_view name, const TokenSpan tokens) {
+        Emit(line, name, tokens.data(), tokens.data() + tokens.size());
+    }
+
+    //Lowers 'if: condition, label;', which jumps to the label unless the condition holds
+    void EmitCondition(const Node& node, const std::string_view label) {
+        Tokens tokens{ Token{ COLON, ":" } };
+        tokens.insert(tokens.end(), node.tokens.begin(), node.tokens.end());
+        tokens.push_back(Token{ COMMA, "," }); tokens.push_back(Token{ ARG, label });
+        Emit(node.line, "if", tokens);
+    }
+
+    void EmitJump(const int& line, const std::string_view label) {
+        Emit(line, "jump", { Token{ COLON, ":" }, Token{ ARG, label } });
+    }
+
+    //Lowers a call and the calls in its arguments. Nested calls run first, last argument first, so their results are on the stack
+    //in the order the parameters bind them
+    void LowerCall(const CallNode& call, const int& line) {
+        for (auto arg = call.args.rbegin(); arg != call.args.rend(); ++arg)
+            if (arg->isCall)
+                LowerCall(*arg, line);
+
+        //Bind each arg to the next parameter slot. The results of nested calls are on the stack
+        for (const CallNode& arg : call.args) {
+            if (arg.isCall)
+                Emit(line, "arg", {});
+            else
+                Emit(line, "arg", { Token{ COLON, ":" }, Token{ ARG, arg.name } });
+        }
+        Emit(line, "call", { Token{ COLON, ":" }, Token{ ARG, call.name } });
+    }
+
+    void LowerNode(const Node& node) {
+        switch (node.kind) {
+            case NODE_INSTRUCTION: {
+                //The name is the first token, the last one is the semicolon
+                const TokenSpan tokens = node.tokens;
+                Emit(node.line, tokens[0].text, tokens.data() + 1, tokens.data() + std::max<size_t>(tokens.size(), 2) - 1);
+                break;
+            }
+            case NODE_LABEL:
+                Label(node.line, node.name);
+                break;
+            case NODE_CALL: {
+                LowerCall(node.block->call, node.line);
+                //Pop the result to its variable. If it is not used, the stack is cleared of it anyway
+                if (node.name.empty())
+                    Emit(node.line, "pop", {});
+                else
+                    Emit(node.line, "pop", { Token{ COLON, ":" }, Token{ ARG, node.name } });
+                break;
+            }
+            case NODE_IF: {
+                const NodeBlock& block = *node.block;
+                const std::string_view end = LabelName("END", node.id);
+                EmitCondition(node, end);
+                for (const Node& child : block.body)
+                    LowerNode(child);
+
+                if (block.elseLine == 0) {
+                    Label(block.endLine, end);
+                    break;
+                }
+                //The end of the if jumps over the else, which starts at the label the if jumps to when its condition fails
+                const std::string_view elseEnd = LabelName("ELSE_END", block.elseId);
+                EmitJump(block.elseLine, elseEnd);
+                Label(block.elseLine, end);
+                for (const Node& child : block.elseBody)
+                    LowerNode(child);
+                Label(block.endLine, elseEnd);
+                break;
+            }
+            case NODE_WHILE:
+            case NODE_FOR: {
+                const NodeBlock& block = *node.block;
+                const std::string_view begin = LabelName(node.kind == NODE_FOR ? "FOR" : "WHILE", node.id), end = LabelName("END", node.id);
+                if (!block.init.empty())
+                    Emit(node.line, "var", block.init);
+                Label(node.line, begin);
+                EmitCondition(node, end);
+                for (const Node& child : block.body)
+                    LowerNode(child);
+
+                //The step and the jump back belong to the loop's header
+                if (block.hasContinue)
+                    Label(node.line, LabelName("CONT", node.id));
+                if (!block.step.empty())
+                    Emit(node.line, block.step[0].text, block.step.subspan(1));
+                EmitJump(node.line, begin);
+                Label(node.line, end);
+                //The variable a for declares only lives as long as the loop
+                if (!block.init.empty())
+                    Emit(node.line, "delete", { Token{ COLON, ":" }, block.init[0] });
+                break;
+            }
+            case NODE_FUNC: {
+                const NodeBlock& block = *node.block;
+                //Jump around the function, in order to prevent getting into it through normal line iteration
+                const std::string_view end = LabelName("END", node.id);
+                EmitJump(node.line, end);
+
+                //The function's range starts at its label and ends with the return after its body. The label after it,
+                //which the jump around the function goes to, belongs to the code around the function
+                const int begin = (int)lowered_.statements.size();
+                program_.AddFunction(string(node.name), block.params, begin);
+                Label(node.line, node.name);
+                for (const Node& child : block.body)
+                    LowerNode(child);
+                Emit(block.endLine, "return", {});
+                program_.GetFunctions().back().SetRange(begin, (int)lowered_.statements.size());
+                Label(block.endLine, end);
+                break;
+            }
+            case NODE_BREAK:
+                EmitJump(node.line, LabelName("END", node.target));
+                break;
+            case NODE_CONTINUE:
+                EmitJump(node.line, LabelName("CONT", node.target));
+                break;
+            case NODE_RETURN: {
+                if (node.tokens.empty())
+                    Emit(node.line, "return", {});
+                else
+                    Emit(node.line, "return", { Token{ COLON, ":" }, node.tokens[0] });
+                break;
+            }
+        }
+    }
+
+    Program& program_;
+    LoweredProgram lowered_;
+};
+
+#endif // !SYNTAX_H
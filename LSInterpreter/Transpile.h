@@ -0,0 +1,241 @@
+#pragma once
+#ifndef TRANSPILE_H
+#define TRANSPILE_H
+
+#include <climits>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Archetypes.h"
+#include "Optimize.h"
+
+using std::vector; using std::string;
+
+// Translates a compiled program into a C++ translation unit built on Runtime.h. Every instruction becomes a statement
+// behind a goto label, calls push the index they return to and returns dispatch on it. Instructions specialized for
+// the types of their operands become plain C++ arithmetic and comparisons on the values.
+
+//Returns: C++ string literal of a string
+string ToCppString(const string& s) {
+    std::ostringstream out;
+    out << '"';
+    for (const unsigned char c : s) {
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (c < 0x20 || c == 0x7F)
+            out << '\\' << std::oct << std::setw(3) << std::setfill('0') << (int)c << std::dec;
+        else
+            out << c;
+    }
+    out << '"';
+    return out.str();
+}
+
+//Returns: C++ literal of a bool, int or double constant
+string ToCppLiteral(const Var& constant) {
+    switch (constant.GetType()) {
+        case DOUBLE: {
+            std::ostringstream out;
+            out << std::setprecision(17) << constant.GetDouble();
+            const string text = out.str();
+            return text.find_first_of(".e") == string::npos ? text + ".0" : text;
+        }
+        case INT:
+            //The smallest int has no literal of type int
+            return constant.GetInt() == INT_MIN ? "(-2147483647 - 1)" : std::to_string(constant.GetInt());
+        case BOOL: return constant.GetBool() ? "true" : "false";
+        default: return string();
+    }
+}
+
+//Returns: C++ expression constructing a constant of the program
+string ToCppConstant(const Var& constant) {
+    switch (constant.GetType()) {
+        case STRING: return "Var(string(" + ToCppString(constant.GetString()) + "))";
+        case DOUBLE:
+        case INT:
+        case BOOL: return "Var(" + ToCppLiteral(constant) + ")";
+        default: return "Var()";
+    }
+}
+
+//Writes the program as C++ to out. 'source' names the script in the header comment
+void EmitCpp(Program& program, std::ostream& out, const string& source) {
+    const vector<InstructionHandle>& code = program.GetCode();
+    const SlotTable slots(program);
+
+    //Instructions control can arrive at other than by falling through: jump targets and the instructions after calls
+    vector<bool> isTarget(code.size() + 1, false); vector<int> returnSites;
+    for (int i = 0; i < (int)code.size(); i++) {
+        const Operands& v = code[i].GetOperands();
+        for (int j = 0; j < v.Size(); j++)
+            if (v[j].GetKind() == OPERAND_LABEL)
+                isTarget[v[j].GetIndex() + 1] = true;
+        if (code[i].GetOpcode() == OP_CALL) {
+            isTarget[i + 1] = true; returnSites.push_back(i);
+        }
+    }
+
+    out << "// Generated from " << source << " by --emit-cpp. Build it with the interpreter's sources on the include path, e.g.\n"
+        << "// g++ -std=c++20 -O2 -I LSInterpreter out.cpp\n"
+        << "#include \"Runtime.h\"\n\n";
+
+    const int constantCount = program.GetConstantCount();
+    if (constantCount > 0) {
+        out << "static const Var k[] = {\n";
+        for (int i = 0; i < constantCount; i++)
+            out << "    " << ToCppConstant(program.GetConstant(i)) << ",\n";
+        out << "};\n\n";
+    }
+
+    out << "int main() {\n"
+        << "    Runtime rt(" << program.GetIdentifierCount() << ", " << program.GetMaxFrameSize() << ");\n"
+        << "    Var* g = rt.Globals(); Var* f = rt.Locals();\n"
+        << "    try {\n";
+
+    for (int i = 0; i < (int)code.size(); i++) {
+        const Operands& v = code[i].GetOperands();
+        const int function = slots.GetOwner(i);
+
+        //Operands as C++: the slot of a var, its value as instructions read it, and the var as instructions write it
+        auto Name = [&](const int& j) {
+            return ToCppString(program.OperandToString(v[j], function));
+        };
+        auto IsSlot = [&](const int& j) {
+            return v[j].GetKind() == OPERAND_VARIABLE || v[j].GetKind() == OPERAND_LOCAL;
+        };
+        auto Slot = [&](const int& j) {
+            return string(v[j].GetKind() == OPERAND_LOCAL ? "f[" : "g[") + std::to_string(v[j].GetIndex()) + "]";
+        };
+        auto Value = [&](const int& j) {
+            if (v[j].GetKind() == OPERAND_CONSTANT)
+                return "k[" + std::to_string(v[j].GetIndex()) + "]";
+            return "rt.Value(" + Slot(j) + ", " + Name(j) + ")";
+        };
+        auto Find = [&](const int& j) {
+            return "rt.Find(" + (IsSlot(j) ? "&" + Slot(j) : string("nullptr")) + ", " + Name(j) + ")";
+        };
+        auto SlotPointer = [&](const int& j) {
+            return IsSlot(j) ? "&" + Slot(j) : string("nullptr");
+        };
+        auto Goto = [&](const int& j) {
+            return "goto L" + std::to_string(v[j].GetIndex() + 1) + ";";
+        };
+        //Operands of specialized instructions: the check of their type, empty for constants, and their value as that type
+        auto IsType = [&](const int& j, const int& type) {
+            if (v[j].GetKind() == OPERAND_CONSTANT)
+                return string();
+            return Slot(j) + ".GetType() == " + (type == INT ? "INT" : "DOUBLE");
+        };
+        auto Typed = [&](const int& j, const int& type) {
+            if (v[j].GetKind() == OPERAND_CONSTANT)
+                return ToCppLiteral(program.GetConstant(v[j].GetIndex()));
+            return Slot(j) + (type == INT ? ".GetInt()" : ".GetDouble()");
+        };
+
+        //Operands are resolved in the order the interpreter resolves them, so the same error is reported first
+        string statement;
+        switch (GetGenericOpcode(code[i].GetOpcode())) {
+            case OP_LABEL: break;
+            case OP_PRINT: statement = "rt.Print(" + Value(0) + ");"; break;
+            case OP_PRINTL: statement = "rt.PrintLine(" + Value(0) + ");"; break;
+            case OP_ENDL: statement = "rt.Endl();"; break;
+            case OP_CLS: statement = "rt.Clear();"; break;
+            case OP_FLUSH: statement = "rt.Flush();"; break;
+            case OP_INPUT: statement = "rt.Input(" + Find(0) + ");"; break;
+            case OP_INPUT_PROMPT: statement = "rt.Print(" + Value(0) + "); rt.Input(" + Find(1) + ");"; break;
+            case OP_READ: statement = "rt.Read(" + Find(0) + ");"; break;
+            case OP_PUSH: statement = "rt.Push(" + Value(0) + ");"; break;
+            case OP_POP: statement = "rt.Pop(" + SlotPointer(0) + ", " + Name(0) + ");"; break;
+            case OP_POP_CLEAR: statement = "rt.PopClear();"; break;
+            case OP_VAR: statement = "{ const Var& value = " + Value(1) + "; rt.Declare(" + Slot(0) + ", value, " + Name(0) + "); }"; break;
+            case OP_VAR_DECLARE: statement = "rt.DeclareEmpty(" + Slot(0) + ", " + Name(0) + ");"; break;
+            case OP_EXIT: statement = "rt.ExitWith(" + Value(0) + ");"; break;
+            case OP_SET: statement = "{ Var& var = " + Find(0) + "; var = " + Value(1) + "; }"; break;
+            case OP_MODIFY: statement = "{ Var& var = " + Find(0) + "; rt.Modify(var, " + std::to_string(v[1].GetIndex()) + ", " + Value(2) + "); }"; break;
+            case OP_STEP: statement = "rt.Step(" + Find(0) + ", " + std::to_string(v[1].GetIndex()) + ");"; break;
+            case OP_APPEND: statement = "rt.Append(" + Find(0) + ", " + Value(1) + ");"; break;
+            case OP_SQRT: statement = "rt.Sqrt(" + Find(0) + ");"; break;
+            case OP_ABS: statement = "rt.Abs(" + Find(0) + ");"; break;
+            case OP_RAND: statement = "rt.Rand(" + Find(0) + ");"; break;
+            case OP_MILLIS: statement = "rt.Millis(" + Find(0) + ");"; break;
+            case OP_SECONDS: statement = "rt.Seconds(" + Find(0) + ");"; break;
+            case OP_DELAY: statement = "rt.Delay(" + Value(0) + ");"; break;
+            case OP_DELETE: statement = "rt.Delete(" + SlotPointer(0) + ");"; break;
+            case OP_JUMP: statement = Goto(0); break;
+            case OP_CALL: {
+                const int callee = v[1].GetIndex();
+                statement = "rt.Call(" + std::to_string(i) + ", " + std::to_string(callee) + ", " + std::to_string(callee == -1 ? 0 : program.GetFunction(callee).GetFrameSize())
+                    + "); g = rt.Globals(); f = rt.Locals(); " + Goto(0);
+                break;
+            }
+            case OP_ARG: statement = "rt.Arg(" + Value(0) + ");"; break;
+            case OP_ARG_POP: statement = "rt.ArgPop();"; break;
+            case OP_RETURN_VALUE: statement = "rt.Push(" + Value(0) + "); goto RETURN;"; break;
+            case OP_RETURN: statement = "goto RETURN;"; break;
+            case OP_IF_COMPARE:
+                statement = "{ const Var& var1 = " + Value(0) + "; const Var& var2 = " + Value(2) + "; if (!rt.Compare(var1, "
+                    + std::to_string(v[1].GetIndex()) + ", var2)) " + Goto(3) + " }";
+                break;
+            case OP_IF_TRUE: statement = "if (!rt.IsTrue(" + (v[0].GetKind() == OPERAND_CONSTANT ? Value(0) : Find(0)) + ")) " + Goto(1); break;
+            case OP_IF_FALSE: statement = "if (!rt.IsFalse(" + (v[0].GetKind() == OPERAND_CONSTANT ? Value(0) : Find(0)) + ")) " + Goto(1); break;
+            case OP_HALT: statement = "rt.Exit(0);"; break;
+            default: throw std::runtime_error("Cannot translate instruction '" + IntToOpcode(code[i].GetOpcode()) + "'");
+        }
+
+        //Specialized instructions run on the values directly. Unless their types were proven, they check them first
+        //and leave any other types to the generic statement
+        int op, type1, type2;
+        if (GetSpecialization(code[i].GetOpcode(), op, type1, type2)) {
+            const int generic = GetGenericOpcode(code[i].GetOpcode());
+            string fast, guard = IsType(0, type1);
+            if (generic == OP_IF_COMPARE) {
+                const string check = IsType(2, type2);
+                guard += guard.empty() || check.empty() ? check : " && " + check;
+                fast = "if (!(" + Typed(0, type1) + " " + IntToOperator(op) + " " + Typed(2, type2) + ")) " + Goto(3);
+            }
+            else if (generic == OP_MODIFY) {
+                const string check = IsType(2, type2);
+                guard += guard.empty() || check.empty() ? check : " && " + check;
+                if (op == DIVIDE || op == MODULO)
+                    fast = "if (" + Typed(2, type2) + " == 0) throw runtime_error(\"" + (op == DIVIDE ? "Division" : "Modulo") + " by 0 attempted\"); ";
+                fast += Slot(0) + ".SetData(" + Typed(0, type1) + " " + IntToOperator(op).substr(0, 1) + " " + Typed(2, type2) + ");";
+            }
+            else
+                fast = Slot(0) + ".SetData(" + Typed(0, type1) + (op == INCREMENT ? " + " : " - ") + (type1 == INT ? "1" : "1.0") + ");";
+
+            const bool isProven = GetUncheckedOpcode(code[i].GetOpcode()) == code[i].GetOpcode();
+            statement = isProven || guard.empty() ? fast : "if (" + guard + ") { " + fast + " } else " + statement;
+        }
+
+        if (isTarget[i])
+            out << "    L" << i << ":\n";
+        if (!statement.empty())
+            out << "        rt.line = " << code[i].GetLine() << "; " << statement << "\n";
+        else if (isTarget[i])
+            out << "        ;\n";
+    }
+    if (isTarget[code.size()])
+        out << "    L" << code.size() << ":\n        rt.Exit(0);\n";
+
+    //Returns continue after the call they return from
+    out << "    RETURN: {\n"
+        << "        const int returnIndex = rt.Return();\n"
+        << "        g = rt.Globals(); f = rt.Locals();\n"
+        << "        switch (returnIndex) {\n";
+    for (const int& site : returnSites)
+        out << "            case " << site << ": goto L" << site + 1 << ";\n";
+    out << "            default: break;\n"
+        << "        }\n"
+        << "    }\n"
+        << "    }\n"
+        << "    catch (const std::runtime_error& e) {\n"
+        << "        rt.ExitError(e.what());\n"
+        << "    }\n"
+        << "    return 0;\n"
+        << "}\n";
+}
+
+#endif // !TRANSPILE_H
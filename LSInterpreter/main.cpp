@@ -2,567 +2,330 @@
 #include <iostream>
 #include <fstream>
 #include "Parse.h"
+#include "Optimize.h"
+#include "Jit.h"
+#include "Profile.h"
+#include "Runtime.h"
+#include "Transpile.h"
+#include "Cache.h"
+#include "Syntax.h"
+#include "Output.h"
+#include "Input.h"
+#include "Stats.h"
 #include <chrono>
 #include <stack>
 #include <thread>
 #include <random>
+#include <charconv>
+#include <cmath>
+#include <list>
+#include <memory>
 
 using std::cout; using std::endl; using std::to_string; using namespace std::chrono;
 using std::pair; using std::make_pair; using std::runtime_error;
 
+//GCC and Clang support taking the address of labels, which the dispatch engine uses for direct threading
+#if defined(__GNUC__) || defined(__clang__)
+#define LS_COMPUTED_GOTO
+#endif
+
+//The tracing JIT emits x86-64 code and hooks into the direct threaded dispatch
+#if defined(LS_COMPUTED_GOTO) && defined(LS_JIT_SUPPORTED)
+#define LS_JIT
+#endif
+
+//Errors are written after what the program printed so far
 void ExitError(const string& error) noexcept {
+    StandardOutput().Flush();
     std::cerr << '\n' << error << "." << endl;
     exit(-1);
 }
 
 void ExitError(const string& error, const int& lineNum) noexcept {
+    StandardOutput().Flush();
     std::cerr << '\n' << error << " on line " << to_string(lineNum) << "." << endl;
     exit(-1);
 }
 
-double GenerateRandomDouble() {
-    //Random engine. 
-    static std::mt19937 rng(static_cast<unsigned int>(steady_clock::now().time_since_epoch().count()));
-    std::uniform_real_distribution<double> dist(0.0, 1.0);
-    return dist(rng);
-}
+#ifdef LS_STATS
+//Writes the statistics of a run for --stats, as text or as JSON. Memory accesses are counted from the slot operands
+//of the instructions dispatched, so they cost nothing while the program runs
+void WriteStats(Program& program, const Stats& stats, std::ostream& out, const bool& json) {
+    const vector<InstructionHandle>& code = program.GetCode();
+    vector<uint64_t> opcodes(OPCODE_COUNT);
+    uint64_t instructions = 0, reads = 0, writes = 0;
+    for (size_t i = 0; i < code.size() && i < stats.executed.size(); i++) {
+        const uint64_t count = stats.executed[i];
+        if (count == 0)
+            continue;
+        instructions += count; opcodes[code[i].GetOpcode()] += count;
 
-double fast_stod(const string& str) {
-    double value;
-    std::from_chars(str.data(), str.data() + str.size(), value);
-    return value;
-}
+        const Operands& operands = code[i].GetOperands();
+        for (int j = 0; j < operands.Size(); j++) {
+            if (operands[j].GetKind() != OPERAND_VARIABLE && operands[j].GetKind() != OPERAND_LOCAL)
+                continue;
+            (IsWriteOperand(code[i].GetOpcode(), j) ? writes : reads) += count;
+        }
+    }
+    const uint64_t declarations = opcodes[OP_VAR] + opcodes[OP_VAR_DECLARE];
+    const char* const phases[PHASE_COUNT] = { "load", "parse", "labels", "compile", "execute" };
+
+    vector<int> order;
+    for (int opcode = 0; opcode < OPCODE_COUNT; opcode++)
+        if (opcodes[opcode] != 0)
+            order.push_back(opcode);
+    std::stable_sort(order.begin(), order.end(), [&opcodes](const int& a, const int& b) { return opcodes[a] > opcodes[b]; });
+
+    if (json) {
+        out << "{\"phases_ms\": {";
+        for (int phase = 0; phase < PHASE_COUNT; phase++)
+            out << (phase == 0 ? "" : ", ") << "\"" << phases[phase] << "\": " << stats.phaseMs[phase];
+        out << "}, \"instructions\": " << instructions << ", \"opcodes\": {";
+        for (size_t i = 0; i < order.size(); i++)
+            out << (i == 0 ? "" : ", ") << "\"" << IntToOpcode(order[i]) << "\": " << opcodes[order[i]];
+        out << "}, \"memory\": {\"reads\": " << reads << ", \"writes\": " << writes << ", \"declarations\": " << declarations
+            << ", \"deletes\": " << opcodes[OP_DELETE] << "}, \"stack_high_water\": " << stats.maxStack
+            << ", \"calls\": " << opcodes[OP_CALL] << ", \"max_call_depth\": " << stats.maxCallDepth
+            << ", \"string_allocations\": " << stats.stringAllocations
+            << ", \"output\": {\"bytes\": " << stats.outputBytes << ", \"flushes\": " << stats.outputFlushes << "}"
+            << ", \"input\": {\"bytes\": " << stats.inputBytes << ", \"reads\": " << stats.inputReads << "}}" << endl;
+        return;
+    }
 
-int fast_stoi(const string& str) {
-    int value;
-    std::from_chars(str.data(), str.data() + str.size(), value);
-    return value;
+    out << "\nStatistics\n";
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        char time[32];
+        std::snprintf(time, sizeof(time), "%.3f ms", stats.phaseMs[phase]);
+        out << "  " << phases[phase] << string(20 - strlen(phases[phase]), ' ') << time << "\n";
+    }
+    out << "  instructions        " << instructions << " dispatched\n"
+        << "  memory              " << reads << " reads, " << writes << " writes, " << declarations << " declarations, " << opcodes[OP_DELETE] << " deletes\n"
+        << "  stack               " << stats.maxStack << " values at most\n"
+        << "  calls               " << opcodes[OP_CALL] << ", " << stats.maxCallDepth << " deep at most\n"
+        << "  strings             " << stats.stringAllocations << " allocated\n"
+        << "  output              " << stats.outputBytes << " bytes in " << stats.outputFlushes << " flushes\n"
+        << "  input               " << stats.inputBytes << " bytes in " << stats.inputReads << " reads\n"
+        << "\nInstructions by opcode\n";
+    for (const int& opcode : order) {
+        const string name = IntToOpcode(opcode);
+        out << "  " << name << string(name.size() < 28 ? 28 - name.size() : 1, ' ') << opcodes[opcode] << "\n";
+    }
+    out.flush();
 }
+#endif
 
 int main(int argc, char* argv[]) {
     if (argc < 1) {
         ExitError("Please specify a path to the file. ");
     }
 
-    std::ifstream file("test.ls"); string line;
+    //Parse the command line. Options come first, the last remaining argument is the path to the file
+    string path = "test.ls", emitPath; bool useLambdaEngine = false, dumpIR = false, useJit = false, useCache = true, profile = false, showStats = false;
+    //Only read by builds with LS_STATS, the others reject --stats
+    [[maybe_unused]] bool statsJson = false;
+    //Output is written line by line to a terminal and in blocks otherwise, unless an option says otherwise
+    Output& output = StandardOutput();
+    Input& input = StandardInput();
+    //Number of threads the front end is split over
+    int jobs = 1;
+    for (int i = 1; i < argc; i++) {
+        const string arg = argv[i];
+        if (arg == "--engine=lambda")
+            useLambdaEngine = true;
+        else if (arg == "--engine=dispatch")
+            useLambdaEngine = false;
+        else if (arg == "--dump-ir")
+            dumpIR = true;
+        else if (arg == "--jit")
+            useJit = true;
+        else if (arg == "--no-cache")
+            useCache = false;
+        else if (arg == "--profile")
+            profile = true;
+        else if (arg == "--stats" || arg == "--stats=json") {
+            showStats = true; statsJson = arg == "--stats=json";
+        }
+        else if (arg == "--unbuffered")
+            output.SetPolicy(FLUSH_ALWAYS);
+        else if (arg == "--flush=line")
+            output.SetPolicy(FLUSH_LINE);
+        else if (arg == "--flush=block")
+            output.SetPolicy(FLUSH_BLOCK);
+        else if (arg == "--emit-cpp") {
+            if (i + 1 >= argc)
+                ExitError("--emit-cpp expects the path of the C++ file to write");
+            emitPath = argv[++i];
+        }
+        else if (arg == "--jobs") {
+            if (i + 1 >= argc || GetDataType(argv[i + 1]) != INT || fast_stoi(argv[i + 1]) < 1)
+                ExitError("--jobs expects a number of threads of at least 1");
+            jobs = fast_stoi(argv[++i]);
+        }
+        else if (arg.rfind("--", 0) == 0)
+            ExitError("Unknown option '" + arg + "'");
+        else
+            path = arg;
+    }
+
+#ifndef LS_JIT
+    if (useJit)
+        ExitError("--jit is only available in x86-64 Linux builds made with GCC or Clang");
+#endif
+    if (useJit && useLambdaEngine)
+        ExitError("--jit runs on top of the dispatch engine");
+#ifndef LS_STATS
+    if (showStats)
+        ExitError("--stats is only available in builds made with LS_STATS defined");
+#endif
+#ifndef LS_PROFILE_SUPPORTED
+    if (profile)
+        ExitError("--profile is only available in Unix builds");
+#endif
+
+    std::ifstream file(path);
 
     if (!file.is_open()) {
         ExitError("Cannot locate or open file.");
     }
+    const string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
     //Start measuring time
     auto start = high_resolution_clock::now();
+    LS_STAT(Stats& stats = GetStats(); auto phaseStart = start);
 
-    //Predefine a map storing all instructions by name
-    std::unordered_map<string, vector<Instruction>> instructions;
-    // Also predefine a map storing statements by name
-    std::unordered_map<string, vector<ControlStructure>> statements;
-
-    //Predefine a map storing all functions. Stores function name and argument count.
-    std::unordered_map<string, int> functions;
+    //Predefine the implementation of every opcode. Which overload a statement calls is looked up in the table of instruction signatures
+    vector<Implementation> implementations(OPCODE_COUNT);
 
-    //Predefine the maps which store the variables based on their names.
-    std::unordered_map<string, Var> memory; memory.reserve(128);
+    //Predefine the memory storing the variables. Every global identifier is resolved to a slot index at load time,
+    //the frames of the running functions are stacked above the globals
+    vector<Var> memory;
     //Predefine a stack, storing variables
     vector<Var> stack; stack.reserve(128);
 
     //Create a list of keywords, which cannot be the names of variables or labels
-    std::unordered_set<string> blacklist = { "string", "double", "int", "bool", "errorLevel" };
+    std::unordered_set<string> blacklist = { "string", "double", "int", "bool", "errorLevel", "true", "false",
+        "if", "else", "for", "while", "break", "continue", "return", "end", "}" };
+
+    //Create the compiled program, which also stores the label's location by name, along with the stack of calls
+    //Operands of compiled instructions index into its constant pool and identifier table
+    Program program; vector<Frame> callStack; callStack.reserve(128);
 
-    //Create a map storing the label's location by name along with a vector storing the line "history"
-    //Also create a lineIndex to keep track of the current line.
-    std::unordered_map<string, int> labelMap; vector<int> callHistory; callHistory.reserve(128);
+    //A fresh .lsc cache next to the script holds its compiled program, so parsing and compiling are skipped. --no-cache always compiles
+    const string cachePath = path + "c"; const uint64_t sourceHash = HashBytes(source.data(), source.size());
+    const bool cached = useCache && LoadProgram(program, cachePath, sourceHash);
+    LS_STAT(EndPhase(PHASE_LOAD, phaseStart));
 
-    //Create a vector storing all the parsed lines, along with the actual line number 
-    vector<pair<int, string>> parsedLines; int parsedLineIndex = 0;
+    //The frame of the running function spans memory[frameBase, frameTop). Arguments of the next call are bound right above it
+    int frameBase = 0, frameTop = 0, currentFunction = -1, argCount = 0, maxFrameSize = 0;
 
-    //Create a vector storing all ControlFlow statement
-    vector<ControlStructureData> statementVec;
+    //The index of the running instruction
+    int parsedLineIndex = 0;
+#ifdef LS_PROFILE_SUPPORTED
+    //Samples parsedLineIndex and the call stack with --profile
+    Profiler profiler;
+#endif
 
     //ErrorLevel is a flag that indicates if certain functions encountered any errors
     int errorLevel = 0;
 
-    // Implement all the statement functions here
-    statements["for"] = vector<ControlStructure>{
-        ControlStructure(TokenTypes{ O_PAREN, ARG, SET, ARG, COMMA, ARG, LOGIC, ARG, COMMA, ARG, MOD, ARG, C_PAREN, O_CURLY  }, [&parsedLines, &statementVec](const vector<string>& v, const int& lineNum) {
-            //For each for-loop segment, parse it
-            const string initializer = v[0] + "=" + v[1], condition = v[2] + v[3] + v[4], iteration = v[5] + v[6] + v[7];
-
-            //Insert all of the necessary lines 
-            string endStatement = iteration + ";jump: FOR_" + to_string(lineNum) + ";=END_" + to_string(lineNum) + ";delete: " + v[0] + ";";
-            string jumpBegin = "FOR_" + to_string(lineNum); string jumpEnd = "END_" + to_string(lineNum);
-            parsedLines.push_back({ lineNum,  "var " + initializer + ";"});
-            parsedLines.push_back({ lineNum,   "=" + jumpBegin + ";"});
-            parsedLines.push_back({ lineNum,  "if: " + condition + "," + jumpEnd + ";" });
-            statementVec.push_back(ControlStructureData(lineNum, FOR, jumpBegin, jumpEnd, endStatement));
-        }),
-        //Override: Iteration is incremental
-        ControlStructure(TokenTypes{ O_PAREN, ARG, SET, ARG, COMMA, ARG, LOGIC, ARG, COMMA, ARG, MOD, C_PAREN, O_CURLY  }, [&parsedLines, &statementVec](const vector<string>& v, const int& lineNum) {
-            //For each for-loop segment, parse it
-            string initializer = v[0] + "=" + v[1], condition = v[2] + v[3] + v[4], iteration = v[5] + v[6];
-
-            //Insert all of the necessary lines 
-            string endStatement = iteration + ";jump: FOR_" + to_string(lineNum) + ";=END_" + to_string(lineNum) + ";delete: " + v[0] + ";";
-            string jumpBegin = "FOR_" + to_string(lineNum); string jumpEnd = "END_" + to_string(lineNum);
-            parsedLines.push_back({ lineNum,  "var " + initializer + ";"});
-            parsedLines.push_back({ lineNum,   "=" + jumpBegin + ";"});
-            parsedLines.push_back({ lineNum,  "if: " + condition + "," + jumpEnd + ";" });
-            statementVec.push_back(ControlStructureData(lineNum, FOR, jumpBegin, jumpEnd, endStatement));
-        }),
-        //Override:  no initializer provided. Iteration is incremental
-        ControlStructure(TokenTypes{ O_PAREN, ARG, LOGIC, ARG, COMMA, ARG, MOD, ARG, C_PAREN, O_CURLY  }, [&parsedLines, &statementVec](const vector<string>& v, const int& lineNum) {
-            //For each for-loop segment, parse it
-            const string condition = v[0] + v[1] + v[2], iteration = v[3] + v[4] + v[5];
-
-            //Insert all of the necessary lines 
-            string endStatement = iteration + ";jump: FOR_" + to_string(lineNum) + ";=END_" + to_string(lineNum) + ";";
-            string jumpBegin = "FOR_" + to_string(lineNum); string jumpEnd = "END_" + to_string(lineNum);
-            parsedLines.push_back({ lineNum,   "=" + jumpBegin + ";"});
-            parsedLines.push_back({ lineNum,  "if: " + condition + "," + jumpEnd + ";" });
-            statementVec.push_back(ControlStructureData(lineNum, FOR, jumpBegin, jumpEnd, endStatement));
-        }),
-        //Override: no initializer provided. Iteration is incremental
-        ControlStructure(TokenTypes{ O_PAREN, ARG, LOGIC, ARG, COMMA, ARG, MOD, C_PAREN, O_CURLY  }, [&parsedLines, &statementVec](const vector<string>& v, const int& lineNum) {
-            //For each for-loop segment, parse it
-            const string condition = v[0] + v[1] + v[2], iteration = v[3] + v[4];
-
-            //Insert all of the necessary lines 
-            string endStatement = iteration + ";jump: FOR_" + to_string(lineNum) + ";=END_" + to_string(lineNum) + ";";
-            string jumpBegin = "FOR_" + to_string(lineNum); string jumpEnd = "END_" + to_string(lineNum);
-            parsedLines.push_back({ lineNum,   "=" + jumpBegin + ";"});
-            parsedLines.push_back({ lineNum,  "if: " + condition + "," + jumpEnd + ";" });
-            statementVec.push_back(ControlStructureData(lineNum, FOR, jumpBegin, jumpEnd, endStatement));
-        }),
-    };
-
-    statements["while"] = vector<ControlStructure>{
-        ControlStructure(TokenTypes{ O_PAREN, ARG, LOGIC, ARG, C_PAREN, O_CURLY  }, [&parsedLines, &statementVec](const vector<string>& v, const int& lineNum) {
-            //Parse the condition
-            string condition = v[0] + v[1] + v[2];
-
-            string jumpBegin = "WHILE_" + to_string(lineNum); string jumpEnd = "END_" + to_string(lineNum);
-            parsedLines.push_back({ lineNum,  "=" + jumpBegin + ";" });
-            parsedLines.push_back({ lineNum,  "if: " + condition + "," + jumpEnd + ";" });
-            string endStatement = "jump: WHILE_" + to_string(lineNum) + ";=END_" + to_string(lineNum) + ";";
-            statementVec.push_back(ControlStructureData(lineNum, WHILE, jumpBegin, jumpEnd, endStatement));
-        }),
-    };
-
-    statements["if"] = vector<ControlStructure>{
-        ControlStructure(TokenTypes{ O_PAREN, ARG, LOGIC, ARG, C_PAREN, O_CURLY  }, [&parsedLines, &statementVec](const vector<string>& v, const int& lineNum) {
-            //Parse the condition
-            string condition = v[0] + v[1] + v[2];
-            //Modify if-statement, in order to jump to the corresponding end if false.
-            string line = "if: " + condition + ", END_" + to_string(lineNum) + ";";
-            parsedLines.push_back({ lineNum, line });
-            statementVec.push_back(ControlStructureData(lineNum, IF, "=END_" + to_string(lineNum) + ";"));
-        }),
-        //Overload: Check if bool is true
-        ControlStructure(TokenTypes{ O_PAREN, ARG, C_PAREN, O_CURLY  }, [&parsedLines, &statementVec](const vector<string>& v, const int& lineNum) {
-            //Parse the condition
-            string condition = v[0];
-            //Modify if-statement, in order to jump to the corresponding end if false.
-            string line = "if: " + condition + ", END_" + to_string(lineNum) + ";";
-            parsedLines.push_back({ lineNum, line });
-            statementVec.push_back(ControlStructureData(lineNum, IF, "=END_" + to_string(lineNum) + ";"));
-        }),
-        //Overload: Check if bool is false
-        ControlStructure(TokenTypes{ O_PAREN, NEG, ARG, C_PAREN, O_CURLY  }, [&parsedLines, &statementVec](const vector<string>& v, const int& lineNum) {
-            //Parse the condition
-            string condition = "!" + v[0];
-            //Modify if-statement, in order to jump to the corresponding end if false.
-            string line = "if: " + condition + ", END_" + to_string(lineNum) + ";";
-            parsedLines.push_back({ lineNum, line });
-            statementVec.push_back(ControlStructureData(lineNum, IF, "=END_" + to_string(lineNum) + ";"));
-        })
-    };
-
-    statements["else"] = vector<ControlStructure>{
-        ControlStructure(TokenTypes{ O_CURLY  }, [&parsedLines, &statementVec](const vector<string>& v, const int& lineNum) {
-            if (statementVec.size() == 0)
-                throw runtime_error("Hanging else-statement received");
-            if (statementVec.back().GetType() != IF)
-                throw runtime_error("Else-statement can only be within an if-statement");
-
-            //Mask else as the end jump, while adding a jump to else_end in order to not go into the else if condition is true
-            parsedLines.push_back({ lineNum, "jump: ELSE_END_" + to_string(lineNum) + ";" });
-            parsedLines.push_back({ lineNum, statementVec.back().GetEndStatement() });
-            statementVec.pop_back();
-            statementVec.push_back(ControlStructureData(lineNum, ELSE, "=ELSE_END_" + to_string(lineNum) + ";"));
-        }),
-    };
+    //Firstly, split the source into statements and their tokens. Secondly, parse them into a syntax tree of the control structures.
+    //Thirdly, lower the tree into the labels and instructions it runs as. Each line of the lowered program becomes one instruction
+    LoweredProgram lowered;
+    if (!cached) {
+        try {
+            const vector<SourceStatement> sourceStatements = LexSource(source, jobs);
+            lowered = Lowering(program).Lower(Parser(sourceStatements).ParseProgram());
+        }
+        catch (const SyntaxError& e) {
+            ExitError(string(e.what()), e.GetLine());
+        }
+    }
+    LS_STAT(EndPhase(PHASE_PARSE, phaseStart));
 
-    statements["break"] = vector<ControlStructure>{
-        ControlStructure(TokenTypes{ SEMICOLON }, [&parsedLines, &statementVec](const vector<string>& v, const int& lineNum) {
-            auto found = std::find_if(statementVec.crbegin(), statementVec.crend(), [](const ControlStructureData& s) {
-                return s.GetType() == FOR || s.GetType() == WHILE;
-            });
+    //Fouth, resolve label names. Labels stay in place as no-ops, so they point at the index of their entry
+    for (int i = 0; i < (int)lowered.statements.size(); i++) {
+        if (!lowered.statements[i].isLabel) continue;
 
-            if (found == statementVec.crbegin())
-                throw runtime_error("A break-statement can only be used within a loop");
+        const string name(lowered.statements[i].name);
+        program.AddLabel(name, i);
+        //also push the label names to the blacklist
+        blacklist.insert(name);
+    }
+    LS_STAT(EndPhase(PHASE_LABELS, phaseStart));
 
-            parsedLines.push_back({ lineNum, "jump: " + (*found).GetJumpEnd() + ";" });
-        }),
+    //Returns: Source text of an operand, used for error messages
+    auto OperandToString = [&program, &currentFunction](const Operand& operand) -> string {
+        return program.OperandToString(operand, currentFunction);
     };
 
-    statements["continue"] = vector<ControlStructure>{
-        ControlStructure(TokenTypes{ SEMICOLON  }, [&parsedLines, &statementVec](const vector<string>& v, const int& lineNum) {
-            auto found = std::find_if(statementVec.rbegin(), statementVec.rend(), [](const ControlStructureData& s) {
-                return s.GetType() == FOR || s.GetType() == WHILE;
-            });
-
-            if (found == statementVec.rbegin())
-                throw runtime_error("A continue-statement can only be used within a loop");
+    //Returns: Operand decoded from an argument token. Literals are parsed once and stored in the constant pool,
+    //labels are patched to the index of the instruction they point to
+    auto CompileOperand = [&program](const string& token, const bool& isLabel) {
+        if (isLabel) {
+            int target = program.FindLabel(token);
+            if (target == -1)
+                throw runtime_error(("Tried to jump to undefined label. Got: '" + token + "'").c_str());
+            return Operand(OPERAND_LABEL, target);
+        }
 
-            //Modify the endStatement accordingly
-            found->SetEndStatement("=CONT_" + to_string(lineNum) + ";" + found->GetEndStatement());
-            parsedLines.push_back({ lineNum, "jump: CONT_" + to_string(lineNum) + ";" });
-        }),
+        int op = GetOperator(token);
+        if (op != NO_OPERATOR)
+            return Operand(OPERAND_OPERATOR, op);
+
+        switch (GetDataType(token)) {
+            case STRING:
+                return Operand(OPERAND_CONSTANT, program.AddConstant(Var(FormatStringA(token))));
+            case DOUBLE:
+                return Operand(OPERAND_CONSTANT, program.AddConstant(Var(fast_stod(token))));
+            case INT:
+                return Operand(OPERAND_CONSTANT, program.AddConstant(Var(fast_stoi(token))));
+            case BOOL:
+                return Operand(OPERAND_CONSTANT, program.AddConstant(Var(token == "true")));
+            default:
+                return Operand(OPERAND_VARIABLE, program.AddIdentifier(token));
+        }
     };
 
-    statements["return"] = vector<ControlStructure>{
-        ControlStructure(TokenTypes{ SEMICOLON }, [&parsedLines, &statementVec](const vector<string>& v, const int& lineNum) {
-            auto found = std::find_if(statementVec.cbegin(), statementVec.cend(), [](const ControlStructureData& s) {
-                return s.GetType() == FUNC;
-            });
-
-            if (found == statementVec.cend())
-                throw runtime_error("A return-statement can only be used within a function");
-
-            parsedLines.push_back({ lineNum, "return;" });
-        }),
-
-        ControlStructure(TokenTypes{ COLON, ARG, SEMICOLON }, [&parsedLines, &statementVec](const vector<string>& v, const int& lineNum) {
-            auto found = std::find_if(statementVec.cbegin(), statementVec.cend(), [](const ControlStructureData& s) {
-                return s.GetType() == FUNC;
-            });
-
-            if (found == statementVec.cend())
-                throw runtime_error("A return-statement can only be used within a function");
-
-            parsedLines.push_back({ lineNum, "return: " + v[0] + ";"});
-        })
+    //Returns: Whether an operand names a memory slot, global or local
+    auto IsSlot = [](const Operand& operand) {
+        return operand.GetKind() == OPERAND_VARIABLE || operand.GetKind() == OPERAND_LOCAL;
     };
 
-    statements["}"] = vector<ControlStructure>{
-        ControlStructure(TokenTypes{ }, [&parsedLines, &statementVec](const vector<string>& v, const int& lineNum) {
-            if (statementVec.size() == 0)
-                throw runtime_error("Received hanging closing curly bracket");
-
-            for (const auto& s : SplitString(statementVec.back().GetEndStatement(), ';'))
-                parsedLines.push_back({ lineNum, s + ";"});
-
-            //Remove the entry in the statementVec
-            statementVec.pop_back();
-        })
+    // Function that returns an operand's memory slot without checks. Locals are relative to the frame of the running function
+    auto Slot = [&memory, &frameBase](const Operand& operand) -> Var& {
+        return memory[operand.GetKind() == OPERAND_LOCAL ? frameBase + operand.GetIndex() : operand.GetIndex()];
     };
 
-    //Append statement names to the blacklist
-    for (const auto& a : statements)
-        blacklist.insert(a.first);
-
-    //Firstly, get the lines and remove any whitespace, while ignoring empty lines. Also store the actual line.  
-    vector<pair<int, string>> lines; int lineIndex = 0;
-    while (getline(file, line)) {
-        ++lineIndex;
-        line = TrimWhitespace(line);
-        if (line == string()) continue;
-        lines.push_back({ lineIndex, line });
-    }
-
-    //an int value to keep track of the statement index
-    int index = 0;
-    //Secondly, parse the lines, check for statements and handle them accordingly
-    for (const auto& [lineNum, l] : lines) {
-        auto parsed = Parse(l);
-
-        if (parsed.size() == 1 && parsed.back().empty())
-            continue;
-
-        //Thirdly, resolve control flow statements
-        for (const string& x : parsed) {
-            ++index;
-            //After seperating semicolons, trim them to get rid of any whitespace inbetween.
-            string parsedLine = TrimWhitespace(x);
-
-            auto tokens = Tokenize(parsedLine);
-            string statementName = tokens[0];
-            if (statements.find(statementName) != statements.cend()) {
-                vector<string> args; TokenTypes argTypes;
-                //For each token, check its token type and push it back to the vector
-                for (int i = 1; i < tokens.size(); i++) {
-                    string token = tokens[i];
-                    //Token is not a seperator, therefore it is an argument
-                    auto found = separators.find(token);
-                    if (found == separators.cend()) {
-                        args.push_back(token); argTypes.push_back(ARG);
-                    }
-                    //Token is a seperator and has a corresponding token type
-                    else {
-                        int argType = (*found).second;
-                        argTypes.push_back(argType);
-                        //As TokenTypes SET and below are unambiguous, do not push them
-                        if (argType > SET)
-                            args.push_back(token);
-                    }
-                }
-
-                //Call the function handling the corresponding control statement
-                try {
-                    auto found = std::find_if(statements[statementName].begin(), statements[statementName].end(), [argTypes](const ControlStructure& s) {
-                        return (s.GetTypes() == argTypes);
-                    });
-
-                    if (found == statements[statementName].end())
-                        ExitError(statementName + " received wrong implementation", lineNum);
-
-                    found->Execute(args, index);
-                }
-                catch (const std::runtime_error& e) {
-                    ExitError(string(e.what()), lineNum);
-                }
-            }
-            else if (statementName == "func") {
-                string funcName = tokens[1];
-
-                //Function should always have at least 5 tokens
-                if (tokens.size() < 5)
-                    ExitError("Invalid args in function definition", lineNum);
-
-                if (tokens.back() != "{")
-                    ExitError("Expected '{' after function definition", lineNum);
-
-                if (!statementVec.empty())
-                    ExitError("Cannot define a function within another", lineNum);
-
-                //Parse the function arguments
-                //2nd index should always be a open bracket
-                if (tokens[2] != "(")
-                    ExitError("Expected '(' in function definition on line", lineNum);
-
-                //2nd to last index should always be a closing bracket
-                if (tokens[tokens.size() - 2] != ")")
-                    ExitError("Expected ')' in function definition on line", lineNum);
-
-                vector<string> args; string lastToken = "";
-
-                for (int i = 3; tokens[i] != ")"; i++) {
-                    string token = tokens[i]; lastToken = token;
-                    auto found = separators.find(token);
-                    //Token is an argument
-                    if (separators.find(token) == separators.cend()) {
-                        args.push_back(token);
-                    }
-                    //If it is a seperator, it should be a ','
-                    else {
-                        if (found->first != ",")
-                            ExitError("Expected ',' in function argument definition", lineNum);
-                        continue;
-                    }
-                }
-
-                //Make sure the last token was indeed an argument
-                if (lastToken == ",")
-                    ExitError("Expected argument got ','", lineNum);
-
-                functions.insert({ funcName, args.size() });
-
-                //Jump to end in order to prevent getting into the function through normal line iteration
-                parsedLines.push_back({ lineNum, "jump: END_" + to_string(index) + ";" });
-                //Function jump
-                parsedLines.push_back({ lineNum, "=" + funcName + ";" });
-                //End statement consisting of the deletes for every created variable
-                string endStatement = "";
-                //Variable predefinitions and pops;
-                for (const auto& arg : args) {
-                    //parsedLines.push_back({ lineNum, "var " + arg + ";" });
-                    parsedLines.push_back({ lineNum, "pop: " + arg + ";" });
-                    endStatement += "delete:" + arg + ";";
-                }
-                //push the return back to the statementVec
-                statementVec.push_back(ControlStructureData(lineNum, FUNC, endStatement + "return;" + "=END_" + to_string(index) + ";"));
-            }
-            //A function call has been found
-            else if (functions.find(statementName) != functions.cend()) {
-                if (tokens.size() < 4)
-                    ExitError("Invalid args provided when calling function", lineNum);
-
-                if (tokens.back() != ";")
-                    ExitError("Expected ';' after calling function", lineNum);
-
-                //Predefine 2 vectors. FuncArgs stores function calls and the arguments.
-                //FuncHistory stores the hierarchy of function calls.
-                std::list<Function> funcArgs; vector<Function*> funcHistory; int lastIndex = 0;
-                //When funcHistory is empty, stop the for loop. Has to execute at least once
-                for (int i = 0; !funcHistory.empty() || i < 1; i++, lastIndex++) {
-                    string token = tokens[i];
-
-                    //If the token is a function, act accordingly
-                    if (functions.find(token) != functions.cend()) {
-                        //If a nested function is within the current function, replace arg with a placeholder
-                        if (!funcHistory.empty()) {
-                            //add placeholder arg
-                            funcHistory.back()->AddArg("func"); lastIndex++;
-                        }
-
-                        //Push a new function call and store function reference in the history
-                        funcArgs.push_back({ token, vector<string>() });
-                        funcHistory.push_back(&funcArgs.back());
-
-                        //Make sure this isn't the last token
-                        if (i >= tokens.size() - 2)
-                            ExitError("Expected '(' when calling function", lineNum);
-
-                        //If the next token isn't a '(', throw an error
-                        if (tokens[i + 1] != "(")
-                            ExitError("Expected '(' when calling function", lineNum);
-
-                        //Skip over the next token, as we have confirmed it is a '('
-                        i++;; continue;
-                    }
-
-                    //As we skip over valid '(', they should not be here
-                    if (token == "(")
-                        ExitError("Hanging '(' received in function call", lineNum);
-
-                    if (token == ")") {
-                        //Make sure functionHistory is not empty
-                        if (funcHistory.empty())
-                            ExitError("Hanging ')' received in function call", lineNum);
-
-                        //Make sure function call doesn't end with ','
-                        if (tokens[i - 1] == ",")
-                            ExitError("Expected argument got ','", lineNum);
-                        funcHistory.pop_back();
-                        continue;
-                    }
-
-                    //If the token is not a seperator, it is an argument
-                    if (separators.find(token) == separators.cend()) {
-                        //Push the arg to the current function
-                        funcHistory.back()->AddArg(token);
-                    }
-                    //if it is a seperator, make sure it is a ','
-                    else if (token != ",")
-                        ExitError("Expected: ',' Got '" + token + "' when calling function", lineNum);
-                }
-
-                //Make sure function call doesn't end with ','
-                if (tokens[lastIndex - 1] == ",")
-                    ExitError("Expected argument got ','", lineNum);
-
-                //Make sure function call ends with ';' or '>>'
-                if (tokens[lastIndex + 1] != ";" && tokens[lastIndex + 1] != ">>")
-                    ExitError("Expected end of function call, got '" + tokens[lastIndex] + "'", lineNum);
-
-                //Reverse functions, as we want to resolve the inner functions first
-                reverse(funcArgs.begin(), funcArgs.end());
-
-                for (const auto& func : funcArgs) {
-                    auto function = *functions.find(func.GetName());
-                    //Reverse function args too, as they get taken out of the stack backwards
-                    auto args = func.GetArgs(); std::reverse(args.begin(), args.end());
-                    //If function args do not match actual args
-                    if (function.second != args.size())
-                        ExitError("No instance of " + function.first + " takes " + to_string(args.size()) + " arguments", lineNum);
-                    //Push each arg to the stack
-                    for (const string& arg : args) {
-                        //Ignore if arg is placeholder
-                        if (arg == "func") continue;
-                        parsedLines.push_back({ lineNum, "push: " + arg + ";" });
-                    }
-                    parsedLines.push_back({ lineNum, "call: " + func.GetName() + ";" }); //Call the function
-                }
-
-                //Function return is getting assigned to a variable 
-                //the next 4 indices represent the variable assigning
-                if (lastIndex + 4 == tokens.size()) {
-                    if (tokens[lastIndex + 1] != ">>")
-                        ExitError("Expected: '>>' Got: '" + tokens[lastIndex + 1] + "'", lineNum);
-                    parsedLines.push_back({ lineNum, "pop: " + tokens[lastIndex + 2] + ";" });
-                }
-                //If the value is below that, clear the stack, since the pushed return value won't be used, causing a memory leak
-                else if(lastIndex + 4 > tokens.size())
-                    parsedLines.push_back({ lineNum, "pop;" });
-                //Throw an error if the value is above that
-                else if (lastIndex + 4 < tokens.size())
-                    ExitError("Invalid args provided when calling function", lineNum);
-            }
-            else 
-                parsedLines.push_back({ lineNum, parsedLine });
+    // Function that returns the variable in an operand's memory slot
+    auto FindVar = [IsSlot, Slot, OperandToString](const Operand& operand) -> Var& {
+        if (IsSlot(operand)) {
+            Var& found = Slot(operand);
+            if (found.IsDefined())
+                return found;
         }
-    }
-
-    //If any statements are still in vec, no end was received.
-    if (statementVec.size() > 0)
-        ExitError("If-statement did not receive end", statementVec.front().GetLine());
 
-    lines.clear();
-
-    //Fouth, resolve label names
-    for (int i = 0; i < parsedLines.size(); i++) {
-        string l = parsedLines[i].second; int lineNum = parsedLines[i].first;
-
-        if (l[0] != '=') continue;
-        if (l.back() != ';') ExitError("Expected semicolon on label initialization. Got: '" + l + "'");
-        string label = FormatLabel(l);
+        throw runtime_error("Instruction received undefined identifier '" + OperandToString(operand) + "'");
+    };
 
-        if (label == string()) ExitError("Incorrect label initialization. Got: '" + l + "'");
+    // Function that returns a var object for an operand. Constants come straight from the pool, variables from memory
+    auto ResolveValue = [&program, Slot, OperandToString](const Operand& operand) -> const Var& {
+        if (operand.GetKind() == OPERAND_CONSTANT)
+            return program.GetConstant(operand.GetIndex());
 
-        labelMap.emplace(label, i);
-        //also push the label names to the blacklist
-        blacklist.insert(label);
-    }
+        //In case of it being a variable, the operand indexes its slot
+        const Var& found = Slot(operand);
+        if (!found.IsDefined())
+            throw std::runtime_error("Instruction received undefined identifier '" + OperandToString(operand) + "'");
 
-    // Function that searches through memory and returns iterator to a variable given a name
-    auto FindVar = [&memory](const std::string& varName) {
-        auto found = memory.find(varName);
-        if (found != memory.cend()) {
-            return found;
-        }
+        // If the type is nothing, it is an uninitialized variable
+        if (found.GetType() == ERROR)
+            throw std::runtime_error("Instruction received uninitialized variable '" + OperandToString(operand) + "'");
 
-        throw runtime_error("Instruction received undefined identifier '" + varName + "'");
+        return found;
     };
 
-    // Function that returns a var object for a specific value. If value is a variable it returns that var 
-    auto ResolveValue = [&memory](const std::string& value) {
-        // Get the type based on data
-        int type = GetDataType(value);
-
-        // If the type is still nothing, perhaps it is a variable
-        if (type == ERROR) {
-            //In case of it being a variable, the value acts as a name
-            auto found = memory.find(value);
-            if (found == memory.cend())
-                throw std::runtime_error("Instruction received undefined identifier '" + value + "'");
-            type = found->second.GetType();
-            // If the type is STILL nothing, it is an uninitialized variable
-            if (type == ERROR)
-                throw std::runtime_error("Instruction received uninitialized variable '" + value + "'");
-
-            return found->second;
-        }
-
-        switch (type) {
-            case STRING: {
-                return Var(value);
-            }
-            case DOUBLE: {
-                return Var(fast_stod(value));
-            }
-            case INT: {
-                return Var(fast_stoi(value));
-            }
-            case BOOL: {
-                if (value == "true")
-                    return Var(true);
-                else
-                    return Var(false);
-            }
-            default: break;
-        }
-    };
-
-    auto ValidateVarName = [&memory, &blacklist](const std::string& varName) {
+    //Checks a variable name when its declaration is compiled. Uniqueness is checked when the declaration runs
+    auto ValidateVarName = [&blacklist](const std::string& varName) {
         // Check for invalid characters and digit-only names
         bool isAllDigits = true;
         for (const char& c : varName) {
@@ -583,28 +346,17 @@ int main(int argc, char* argv[]) {
         if (isAllDigits) {
             throw std::runtime_error("Variable initialization received digit-only name. Got: '" + varName + "'");
         }
-
-        // Name should be unique
-        if (memory.find(varName) != memory.cend()) {
-            throw std::runtime_error("Variable by the name of '" + varName + "' already defined");
-        }
         };
 
-    //Returns: Instruction implementation by name and TokenTypes
-    auto FindInstruction = [&instructions](const std::string& funcName, const TokenTypes& types) {
-        // Find the Instruction vector given the name
-        const auto found = instructions.find(funcName);
-        if (found == instructions.cend())
+    //Returns: Opcode of the instruction overload matching name and TokenTypes
+    auto FindInstruction = [](const std::string& funcName, const TokenTypes& types) {
+        if (!IsInstructionName(funcName))
             throw std::runtime_error("Instruction expected, got: '" + funcName + "'");
 
-        const auto funcSet = found->second;
-
-        // Get the corresponding Instruction implementation based on the types
-        const auto func = std::find_if(funcSet.cbegin(), funcSet.cend(), [&types](const Instruction& f) {
-            return f.GetTypes() == types;
-            });
+        // Get the overload based on the types
+        const int opcode = FindOpcode(funcName, EncodeSignature(types));
 
-        if (func == funcSet.cend()) {
+        if (opcode == -1) {
             // Build the error message
             std::string error;
             for (const auto& a : types)
@@ -619,704 +371,1184 @@ int main(int argc, char* argv[]) {
             throw std::runtime_error("No overload for Instruction '" + funcName + "' matches types: " + error);
         }
 
-        return func->GetImplementation();
+        return opcode;
     };
 
-    auto FindInstructionA = [&instructions](const std::string& funcName) {
-        // Find the Instruction vector given the name
-        const auto found = instructions.find(funcName);
-        if (found == instructions.cend())
-            throw std::runtime_error("Instruction expected, got: '" + funcName + "'");
-
-        //Return the first implementation of the function with a given name
-        return found->second.begin()->GetImplementation();
+    // Writes a value to the console
+    auto Print = [&output](const Var& var1) {
+        output.Print(var1);
     };
 
-    instructions["print"] = vector<Instruction>{
-        Instruction(TokenTypes{ COLON, ARG }, [ResolveValue](const Arguments& v) {
-            const Var& var1 = ResolveValue(v[0]); int type = var1.GetType();
+    // Reads a line from the console into a variable
+    auto Input = [&](const Operand& operand) {
+        Var& var1 = FindVar(operand); int type = var1.GetType();
+        // Reset errorLevel to 0 
+        errorLevel = 0;
+
+        // Get the line and its datatype. If it's errortype, it becomes a string, due to it not being anything else.
+        // Anything printed before, such as a prompt, is shown before waiting for input
+        string s = "";
+        if (!input.ReadLine(s)) {
+            errorLevel = INPUT_END; return;
+        }
+        int lineType = GetDataType(s);
 
-            switch (type) {
-                case STRING: {
-                    auto val1 = get<string>(var1.GetData()); FormatString(val1);
-                    cout << val1;
-                    break;
-                }
-                case DOUBLE: {
-                    auto val1 = get<double>(var1.GetData());
-                    cout << (val1);
-                    break;
-                }
-                case INT: {
-                    auto val1 = get<int>(var1.GetData());
-                    cout << to_string(val1);
-                    break;
-                }
-                case BOOL: {
-                    auto val1 = get<bool>(var1.GetData());
-                    if (val1)
-                        cout << "true";
-                    else
-                        cout << "false";
-                    break;
-                }
-                default: break;
+        if (lineType == ERROR)
+            lineType = STRING;
+
+        // Uninitialized variable as target, set it to the lineType
+        if (type == ERROR)
+            type = lineType;
+
+        // Set errorLevel to 1, indicating a type mismatch, unless type is a string, due to strings being everything theoretically.  
+        if (type != lineType && type != STRING) {
+            errorLevel = 1; return;
+        }
+
+        //Set the variable to the line
+        switch (type) {
+            case STRING: {
+                var1.SetData(FormatStringA(s));
+                break;
+            }
+            case DOUBLE: {
+                var1.SetData(fast_stod(s));
+                break;
+            }
+            case INT: {
+                var1.SetData(fast_stoi(s));
+                break;
             }
-        })
+            case BOOL: {
+                if (s == "true")
+                    var1.SetData(true);
+                else
+                    var1.SetData(false);
+                break;
+            }
+            default: break;
+        }
     };
 
-    instructions["printl"] = vector<Instruction>{
-        Instruction(TokenTypes{ COLON, ARG }, [FindInstructionA](const Arguments& v) {
-            FindInstructionA("print")(vector<string> { v[0] });
-            cout << "\n";
-        })
+    // Pushes a value onto the stack
+    auto Push = [&stack, ResolveValue](const Operand& operand) {
+        const Var& var1 = ResolveValue(operand);
+
+        if (var1.GetType() == ERROR)
+            throw runtime_error("Tried pushing uninitialized variable onto stack");
+
+        stack.emplace_back(var1);
+        LS_STAT(GetStats().maxStack = std::max(GetStats().maxStack, stack.size()));
     };
 
-    instructions["endl"] = vector<Instruction>{
-        Instruction(TokenTypes{}, [ResolveValue](const Arguments& v) {
-            cout << endl;
-        })
+    // Releases a variable's memory slot. Sets errorLevel if it does not exist
+    auto Delete = [IsSlot, Slot, &errorLevel](const Operand& operand) {
+        errorLevel = 0;
+        if (!IsSlot(operand) || !Slot(operand).IsDefined()) {
+            errorLevel = 1; return;
+        }
+
+        Slot(operand).Release();
     };
 
-    instructions["cls"] = vector<Instruction>{
-        Instruction(TokenTypes{}, [ResolveValue](const Arguments& v) {
-            // Istg this is the best way to do this
-            cout << "\033[2J\033[1;1H" << endl;
-        })
+    // Moves execution to a label. Its index was resolved when the instruction was compiled
+    auto JumpTo = [&parsedLineIndex](const Operand& operand) {
+        parsedLineIndex = operand.GetIndex();
     };
 
-    instructions["input"] = vector<Instruction>{
-        Instruction(TokenTypes{ COLON, ARG }, [&](const Arguments& v) {
-            Var& var1 = FindVar(v[0])->second; int type = var1.GetType();
-            // Reset errorLevel to 0 
-            errorLevel = 0;
+    // Prints the exit message and terminates the program. With --profile the report follows it
+    auto Exit = [&](const int& code) {
+        output.Write("\nProgram sucessfully executed. Exited with code " + to_string(code) + ".\nElapsed time: "
+            + to_string(duration_cast<milliseconds>(high_resolution_clock::now() - start).count()) + " ms\n");
+        output.Flush();
+#ifdef LS_STATS
+        EndPhase(PHASE_EXECUTE, phaseStart);
+        if (showStats)
+            WriteStats(program, stats, std::cerr, statsJson);
+#endif
+#ifdef LS_PROFILE_SUPPORTED
+        if (profile) {
+            profiler.Stop();
+            std::ofstream folded(path + ".folded");
+            profiler.Report(program, source, std::cerr, folded);
+            std::cerr << "\nCollapsed stacks written to " << path << ".folded" << endl;
+        }
+#endif
 
-            // Get the line and its datatype. If it's errortype, it becomes a string, due to it not being anything else
-            string s = ""; std::getline(std::cin, s); int lineType = GetDataType(s);
+        exit(code);
+    };
 
-            if (lineType == ERROR)
-                lineType = STRING;
+    implementations[OP_PRINT] = [ResolveValue, Print](const Operands& v) {
+        Print(ResolveValue(v[0]));
+    };
 
-            // Uninitialized variable as target, set it to the lineType
-            if (type == ERROR)
-                type = lineType;
+    implementations[OP_PRINTL] = [ResolveValue, Print, &output](const Operands& v) {
+        Print(ResolveValue(v[0]));
+        output.Write('\n');
+    };
 
-            // Set errorLevel to 1, indicating a type mismatch, unless type is a string, due to strings being everything theoretically.  
-            if (type != lineType && type != STRING) {
-                errorLevel = 1; return;
-            }
+    implementations[OP_ENDL] = [&output](const Operands& v) {
+        output.Write('\n');
+    };
 
-            //Set the variable to the line
-            switch (type) {
-                case STRING: {
-                    var1.SetData(line);
-                    break;
-                }
-                case DOUBLE: {
-                    var1.SetData(fast_stod(line));
-                    break;
-                }
-                case INT: {
-                    var1.SetData(fast_stoi(line));
-                    break;
-                }
-                case BOOL: {
-                    if (line == "true")
-                        var1.SetData(true);
-                    else
-                        var1.SetData(false);
-                    break;
-                }
-                default: break;
-            }
-        }),
-        // Overload: Print a string before inputting. 
-        Instruction(TokenTypes{ COLON, ARG, COMMA, ARG }, [&](const Arguments& v) {
-            cout << FormatStringA(v[0]); FindInstruction("input", TokenTypes{ COLON, ARG })(Arguments { v[1] });
-        })
+    implementations[OP_CLS] = [&output](const Operands& v) {
+        // Istg this is the best way to do this
+        output.Write("\033[2J\033[1;1H\n");
+        output.Flush();
     };
 
-    instructions["push"] = vector<Instruction>{
-        Instruction(TokenTypes{ COLON, ARG }, [&stack, ResolveValue](const Arguments& v) {
-            const Var& var1 = ResolveValue(v[0]);
+    implementations[OP_FLUSH] = [&output](const Operands& v) {
+        output.Flush();
+    };
 
-            if (var1.GetType() == ERROR)
-                throw runtime_error("Tried pushing uninitialized variable '" + v[0] + "' onto stack");
+    implementations[OP_INPUT] = [Input](const Operands& v) {
+        Input(v[0]);
+    };
+    // Overload: Print a string before inputting.
+    implementations[OP_INPUT_PROMPT] = [ResolveValue, Print, Input](const Operands& v) {
+        Print(ResolveValue(v[0])); Input(v[1]);
+    };
 
-            // Push it to the stack
-            stack.emplace_back(var1);
-        })
+    // Reads the next field of the input into a variable. Sets errorLevel on a type mismatch or at the end of the input
+    implementations[OP_READ] = [FindVar, &input, &errorLevel](const Operands& v) {
+        errorLevel = input.Read(FindVar(v[0]));
     };
 
-    instructions["pop"] = vector<Instruction>{
-        Instruction(TokenTypes{ COLON, ARG }, [&memory, FindVar, &stack, &errorLevel](const Arguments& v) {
-            // Reset errorLevel
-            errorLevel = 0;
-            auto it = memory.find(v[0]);
+    implementations[OP_PUSH] = [Push](const Operands& v) {
+        Push(v[0]);
+    };
 
-            if (stack.empty()) {
-                errorLevel = 1; return;
-            }
+    auto PopVar = [IsSlot, Slot, OperandToString, &stack, &errorLevel](const Operands& v) {
+        // Reset errorLevel
+        errorLevel = 0;
 
-            //Variable does not exist, initialize it. 
-            if (it == memory.cend()) {
-                memory[v[0]] = stack.back(); stack.pop_back();
-                return;
-            }
+        if (stack.empty()) {
+            errorLevel = 1; return;
+        }
 
-            //Get the top of the stack
-            const Var& top = stack.back();
-            stack.pop_back();
+        if (!IsSlot(v[0]))
+            throw runtime_error("Pop received invalid identifier '" + OperandToString(v[0]) + "'");
 
+        //Get the top of the stack
+        Var top = std::move(stack.back());
+        stack.pop_back();
 
-            const int& topType = top.GetType();
-            const Data& topData = top.GetData();
-            //Get the variable from the iterator.
-            Var& var1 = it->second; int type = var1.GetType();
+        //Variable does not exist, initialize it. 
+        Var& var1 = Slot(v[0]);
+        if (!var1.IsDefined()) {
+            var1 = std::move(top);
+            return;
+        }
 
-            // Uninitialized variable as target, set type to topType
-            if (type == ERROR)
-                type = topType;
+        int type = var1.GetType(); const int topType = top.GetType();
 
-            if (type != topType)
-                throw runtime_error("Pop received wrong type Got: '" + IntToType(type) + "' Expected: '" + IntToType(topType));
+        // Uninitialized variable as target, set type to topType
+        if (type == ERROR)
+            type = topType;
 
-            switch (type) {
-                case STRING: {
-                    std::string val1 = std::get<std::string>(topData);
-                    FormatString(val1);
-                    var1.SetData(std::move(val1));
-                    break;
-                }
-                case DOUBLE: {
-                    var1.SetData(std::get<double>(topData));
-                    break;
-                }
-                case INT: {
-                    var1.SetData(std::get<int>(topData));
-                    break;
-                }
-                case BOOL: {
-                    var1.SetData(std::get<bool>(topData));
-                    break;
-                }
-                default: break;
-            }
-        }),
-        Instruction(TokenTypes{ }, [&stack](const Arguments& v) {
-            stack.clear();
-        })
+        if (type != topType)
+            throw runtime_error("Pop received wrong type Got: '" + IntToType(type) + "' Expected: '" + IntToType(topType));
+
+        var1 = std::move(top);
     };
 
-    instructions["var"] = vector<Instruction>{
-        Instruction(TokenTypes{ ARG, SET, ARG }, [&](const Arguments& v) {
-            const string& name = v[0];
-            const Var& var1 = ResolveValue(v[1]); int type = var1.GetType();
+    implementations[OP_POP] = PopVar;
+    implementations[OP_POP_CLEAR] = [&stack](const Operands& v) {
+        stack.clear();
+    };
 
-            ValidateVarName(name);
-            switch (type) {
-                case STRING: {
-                    memory[name] = Var(FormatStringA(get<string>(var1.GetData())));
-                    break;
-                }
-                case DOUBLE: {
-                    memory[name] = Var(get<double>(var1.GetData()));
-                    break;
-                }
-                case INT: {
-                    memory[name] = Var(get<int>(var1.GetData()));
-                    break;
-                }
-                case BOOL: {
-                    memory[name] = Var(get<bool>(var1.GetData()));
-                    break;
-                }
-                default: break;
-            }
-        }),
-        // Overload: Define variable, but do not initialize it
-        Instruction(TokenTypes{ ARG }, [&memory, ValidateVarName](const Arguments& v) {
-            const string& name = v[0];
-            ValidateVarName(name);
-
-            memory[name] = Var();
-        })
+    auto DeclareVar = [Slot, OperandToString, ResolveValue](const Operands& v) {
+        const Var& var1 = ResolveValue(v[1]);
+
+        // Name should be unique. The slot was validated when the declaration was compiled
+        Var& var0 = Slot(v[0]);
+        if (var0.IsDefined())
+            throw std::runtime_error("Variable by the name of '" + OperandToString(v[0]) + "' already defined");
+
+        var0 = var1;
+    };
+
+    auto DeclareEmptyVar = [Slot, OperandToString](const Operands& v) {
+        Var& var0 = Slot(v[0]);
+        if (var0.IsDefined())
+            throw std::runtime_error("Variable by the name of '" + OperandToString(v[0]) + "' already defined");
+
+        var0 = Var();
     };
 
-    instructions["exit"] = vector<Instruction>{
-        Instruction(TokenTypes{ COLON, ARG }, [ResolveValue, start](const Arguments& v) {
-            const Var& var1 = ResolveValue(v[0]); int type = var1.GetType();
+    implementations[OP_VAR] = DeclareVar;
+    // Overload: Define variable, but do not initialize it
+    implementations[OP_VAR_DECLARE] = DeclareEmptyVar;
 
-            if (type != INT) throw runtime_error(("Exit requires argument type: 'int' got: '" + IntToType(type) + "'").c_str());
-            int code = get<int>(var1.GetData());
+    auto ExitInstruction = [ResolveValue, Exit](const Operands& v) {
+        const Var& var1 = ResolveValue(v[0]); int type = var1.GetType();
 
-            cout << endl << "Program sucessfully executed. Exited with code " + to_string(code) + "." << endl <<
-                "Elapsed time: " << duration_cast<milliseconds>(high_resolution_clock::now() - start).count() << " ms" << endl;
+        if (type != INT) throw runtime_error(("Exit requires argument type: 'int' got: '" + IntToType(type) + "'").c_str());
 
-            exit(code);
-        })
+        Exit(var1.GetInt());
     };
 
-    auto ModifyVar = [](Var& var1, const auto& val1, const auto& val2, const string& op) {
-        if (op == "+=")
-            var1.SetData(val1 + val2);
-        else if (op == "-=")
-            var1.SetData(val1 - val2);
-        else if (op == "*=")
-            var1.SetData(val1 * val2);
-        else if (op == "/=") {
-            if (val2 == 0.0)
-                throw runtime_error("Division by 0 attempted");
-
-            var1.SetData(val1 / val2);
-        }
-        else if (op == "%=") {
-            // Make sure modulo is only used with integers
-            if constexpr (std::is_integral_v<std::decay_t<decltype(val1)>> && std::is_integral_v<std::decay_t<decltype(val2)>>) {
-                if (val2 == 0) {
-                    throw runtime_error("Modulo by 0 attempted");
+    implementations[OP_EXIT] = ExitInstruction;
+
+    auto ModifyVar = [](Var& var1, const auto& val1, const auto& val2, const int& op) {
+        switch (op) {
+            case ADD:
+                var1.SetData(val1 + val2);
+                break;
+            case SUBTRACT:
+                var1.SetData(val1 - val2);
+                break;
+            case MULTIPLY:
+                var1.SetData(val1 * val2);
+                break;
+            case DIVIDE:
+                if (val2 == 0.0)
+                    throw runtime_error("Division by 0 attempted");
+
+                var1.SetData(val1 / val2);
+                break;
+            case MODULO:
+                // Make sure modulo is only used with integers
+                if constexpr (std::is_integral_v<std::decay_t<decltype(val1)>> && std::is_integral_v<std::decay_t<decltype(val2)>>) {
+                    if (val2 == 0) {
+                        throw runtime_error("Modulo by 0 attempted");
+                    }
+                    var1.SetData(val1 % val2);
                 }
-                var1.SetData(val1 % val2);
-            }
-            else
-                throw runtime_error("Modulo operation is only valid for integral types");
+                else
+                    throw runtime_error("Modulo operation is only valid for integral types");
+                break;
+            default: break;
         }
     };
 
-    instructions["[VarName]"] = vector<Instruction>{
-        // Sets a variable to a value
-        // the final line should look like [VarName] var1 = value, thus having an additional 0 prepended.
-        Instruction(TokenTypes{ ARG, SET, ARG }, [&](const Arguments& v) {
-            Var& var0 = FindVar(v[0])->second;
-            const Var& var1 = ResolveValue(v[1]);
-            int type = var1.GetType();
-
-            switch (type) {
-                case STRING: {
-                    var0.SetData(FormatStringA(get<string>(var1.GetData())));
-                    break;
+    // Sets a variable to a value
+    auto Assign = [FindVar, ResolveValue](const Operands& v) {
+        Var& var0 = FindVar(v[0]);
+        const Var& var1 = ResolveValue(v[1]);
+
+        var0 = var1;
+    };
+
+    //Modifying a variable
+    auto Modify = [FindVar, ResolveValue, ModifyVar](const Operands& v) {
+        Var& var1 = FindVar(v[0]); int nameType = var1.GetType();
+        const Var& var2 = ResolveValue(v[2]); int valueType = var2.GetType();
+        const int op = v[1].GetIndex();
+
+
+        // If it isn't the same type, or number type.
+        if (nameType != valueType && !(nameType == DOUBLE && valueType == INT) && !(nameType == INT && valueType == DOUBLE))
+            throw runtime_error(("Arithmetic operation received wrong type. Got: '" + IntToType(valueType) + "' Expected: '" + IntToType(nameType) + "'").c_str());
+
+        if (nameType == BOOL)
+            throw runtime_error("Cannot perform arithmetic operation on type 'bool'");
+
+        if (nameType == STRING && op != ADD)
+            throw runtime_error(("Cannot use operator '" + IntToOperator(op) + "' on a string").c_str());
+        else if (nameType == STRING) {
+            var1.Append(var2.GetString());
+            return;
+        }
+
+        switch (nameType) {
+            case DOUBLE: {
+                auto val1 = var1.GetDouble();
+                if (valueType == DOUBLE) {
+                    auto val2 = var2.GetDouble();
+                    ModifyVar(var1, val1, val2, op);
                 }
-                case DOUBLE: {
-                    var0.SetData(get<double>(var1.GetData()));
-                    break;
+                else {
+                    auto val2 = var2.GetInt();
+                    ModifyVar(var1, val1, val2, op);
                 }
-                case INT: {
-                    var0.SetData(get<int>(var1.GetData()));
-                    break;
+                break;
+            }
+            case INT: {
+                auto val1 = var1.GetInt();
+                if (valueType == DOUBLE) {
+                    auto val2 = var2.GetDouble();
+                    ModifyVar(var1, val1, val2, op);
                 }
-                case BOOL: {
-                    var0.SetData(get<bool>(var1.GetData()));
-                    break;
+                else {
+                    auto val2 = var2.GetInt();
+                    ModifyVar(var1, val1, val2, op);
                 }
-                default: break;
-            }
-        }),
-        //Modifying a variable
-        Instruction(TokenTypes{ ARG, MOD, ARG }, [&](const Arguments& v) {
-            Var& var1 = FindVar(v[0])->second; int nameType = var1.GetType();
-            const Var& var2 = ResolveValue(v[2]); int valueType = var2.GetType();
-            const string& op = v[1];
-
-
-            // If it isn't the same type, or number type.
-            if (nameType != valueType && !(nameType == DOUBLE && valueType == INT) && !(nameType == INT && valueType == DOUBLE))
-                throw runtime_error(("Arithmetic operation received wrong type. Got: '" + IntToType(valueType) + "' Expected: '" + IntToType(nameType) + "'").c_str());
-
-            if (nameType == BOOL)
-                throw runtime_error("Cannot perform arithmetic operation on type 'bool'");
-
-            if (nameType == STRING && op != "+=")
-                throw runtime_error(("Cannot use operator '" + op + "' on a string").c_str());
-            else if (nameType == STRING) {
-                auto val1 = get<string>(var1.GetData());
-                auto val2 = get<string>(var2.GetData());
-                var1.SetData(val1 + FormatStringA(val2));
-                return;
+                break;
             }
+            default: break;
+        }
+    };
 
-            switch (nameType) {
-                case DOUBLE: {
-                    auto val1 = get<double>(var1.GetData());
-                    if (valueType == DOUBLE) {
-                        auto val2 = get<double>(var2.GetData());
-                        ModifyVar(var1, val1, val2, op);
-                    }
-                    else {
-                        auto val2 = get<int>(var2.GetData());
-                        ModifyVar(var1, val1, val2, op);
-                    }
-                    break;
-                }
-                case INT: {
-                    auto val1 = get<int>(var1.GetData());
-                    if (valueType == DOUBLE) {
-                        auto val2 = get<double>(var2.GetData());
-                        ModifyVar(var1, val1, val2, op);
-                    }
-                    else {
-                        auto val2 = get<int>(var2.GetData());
-                        ModifyVar(var1, val1, val2, op);
-                    }
-                    break;
-                }
-                default: break;
+    // Incrementing or decrementing variable
+    auto Step = [FindVar](const Operands& v) {
+        Var& var1 = FindVar(v[0]); int type = var1.GetType();
+        const int op = v[1].GetIndex();
+
+        if (op != INCREMENT && op != DECREMENT)
+            throw runtime_error("Wrong operator received. Expected '++' or '--'");
+
+        switch (type) {
+            case DOUBLE: {
+                auto val1 = var1.GetDouble();
+                if (op == INCREMENT)
+                    var1.SetData(val1 + 1.0);
+                else
+                    var1.SetData(val1 - 1.0);
+                break;
             }
-        }),
-        // Incrementing or decrementing variable
-        Instruction(TokenTypes{ ARG, MOD }, [&](const Arguments& v) {
-            Var& var1 = FindVar(v[0])->second; int type = var1.GetType();
-            const string& op = v[1];
-
-            if (op != "++" && op != "--")
-                throw runtime_error("Wrong operator received. Expected '++' or '--'");
-
-            switch (type) {
-                case DOUBLE: {
-                    auto val1 = get<double>(var1.GetData());
-                    if (op == "++")
-                        var1.SetData(val1 + 1.0);
-                    else if (op == "--")
-                        var1.SetData(val1 - 1.0);
-                    break;
-                }
-                case INT: {
-                    auto val1 = get<int>(var1.GetData());
-                    if (op == "++")
-                        var1.SetData(val1 + 1);
-                    else if (op == "--")
-                        var1.SetData(val1 - 1);
-                    break;
-                }
-                default: throw runtime_error("Cannot use operator '" + op + "' on type '" + IntToType(type) + "'"); break;
+            case INT: {
+                auto val1 = var1.GetInt();
+                if (op == INCREMENT)
+                    var1.SetData(val1 + 1);
+                else
+                    var1.SetData(val1 - 1);
+                break;
             }
-        })
+            default: throw runtime_error("Cannot use operator '" + IntToOperator(op) + "' on type '" + IntToType(type) + "'"); break;
+        }
     };
 
-    instructions["sqrt"] = vector<Instruction>{
-        Instruction(TokenTypes{ COLON, ARG }, [&](const Arguments& v) {
-            Var& var1 = FindVar(v[0])->second; int nameType = var1.GetType();
+    // Appends a value to a string the way print shows it. A string built piece by piece grows in place, so it is copied once at most
+    auto Append = [FindVar, ResolveValue](const Operands& v) {
+        Var& var1 = FindVar(v[0]); const Var& var2 = ResolveValue(v[1]);
+        if (var2.GetType() == ERROR)
+            throw runtime_error("Tried appending uninitialized variable");
+        if (var1.GetType() == ERROR)
+            var1.SetData(std::string_view());
+        else if (var1.GetType() != STRING)
+            throw runtime_error("Append received wrong type. Got: '" + IntToType(var1.GetType()) + "' Expected: 'string'");
+
+        char digits[32];
+        var1.Append(FormatValue(var2, digits));
+    };
 
-            // If it isn't the same type, or number type.
-            if (nameType != DOUBLE && nameType != INT)
-                throw runtime_error(("Square root operation received wrong type. Got: '" + IntToType(nameType) + "'").c_str());
+    implementations[OP_SET] = Assign;
+    implementations[OP_MODIFY] = Modify;
+    implementations[OP_STEP] = Step;
+    implementations[OP_APPEND] = Append;
 
-            switch (nameType) {
-                case DOUBLE: {
-                    auto val1 = get<double>(var1.GetData());
-                    var1.SetData(sqrt(val1));
-                    break;
-                }
-                case INT: {
-                    auto val1 = get<int>(var1.GetData());
-                    var1.SetData((int)sqrt(val1));
-                    break;
-                }
+    auto SquareRoot = [FindVar](const Operands& v) {
+        Var& var1 = FindVar(v[0]); int nameType = var1.GetType();
+
+        // If it isn't the same type, or number type.
+        if (nameType != DOUBLE && nameType != INT)
+            throw runtime_error(("Square root operation received wrong type. Got: '" + IntToType(nameType) + "'").c_str());
+
+        switch (nameType) {
+            case DOUBLE: {
+                auto val1 = var1.GetDouble();
+                var1.SetData(sqrt(val1));
+                break;
+            }
+            case INT: {
+                auto val1 = var1.GetInt();
+                var1.SetData((int)sqrt(val1));
+                break;
             }
-        })
+        }
     };
 
-    instructions["abs"] = vector<Instruction>{
-        Instruction(TokenTypes{ COLON, ARG }, [&](const Arguments& v) {
-            Var& var1 = FindVar(v[0])->second; int nameType = var1.GetType();
+    implementations[OP_SQRT] = SquareRoot;
 
-            // If it isn't the same type, or number type.
-            if (nameType != DOUBLE && nameType != INT)
-                throw runtime_error(("Absolute operation received wrong type. Got: '" + IntToType(nameType) + "'").c_str());
+    implementations[OP_ABS] = [FindVar](const Operands& v) {
+        Var& var1 = FindVar(v[0]); int nameType = var1.GetType();
 
-            switch (nameType) {
-                case DOUBLE: {
-                    auto val1 = get<double>(var1.GetData());
-                    var1.SetData(abs(val1));
-                    break;
-                }
-                case INT: {
-                    auto val1 = get<int>(var1.GetData());
-                    var1.SetData(abs(val1));
-                    break;
-                }
+        // If it isn't the same type, or number type.
+        if (nameType != DOUBLE && nameType != INT)
+            throw runtime_error(("Absolute operation received wrong type. Got: '" + IntToType(nameType) + "'").c_str());
+
+        switch (nameType) {
+            case DOUBLE: {
+                auto val1 = var1.GetDouble();
+                var1.SetData(abs(val1));
+                break;
             }
-        })
+            case INT: {
+                auto val1 = var1.GetInt();
+                var1.SetData(abs(val1));
+                break;
+            }
+        }
     };
 
     //Gives random double between 0 and 1
-    instructions["rand"] = vector<Instruction>{
-        Instruction(TokenTypes{ COLON, ARG }, [&](const Arguments& v) {
-            Var& var1 = FindVar(v[0])->second;
-            var1.SetData(GenerateRandomDouble());
-        })
+    implementations[OP_RAND] = [FindVar](const Operands& v) {
+        Var& var1 = FindVar(v[0]);
+        var1.SetData(GenerateRandomDouble());
     };
 
     //Function that gives the elapsed time in milliseconds since the program started
-    instructions["millis"] = vector<Instruction>{
-        Instruction(TokenTypes{ COLON, ARG }, [&](const Arguments& v) {
-            Var& var1 = FindVar(v[0])->second;
-            var1.SetData((int)duration_cast<milliseconds>(high_resolution_clock::now() - start).count());
-        })
+    implementations[OP_MILLIS] = [FindVar, start](const Operands& v) {
+        Var& var1 = FindVar(v[0]);
+        var1.SetData((int)duration_cast<milliseconds>(high_resolution_clock::now() - start).count());
     };
 
     //Function that gives the elapsed time in seconds since the program started
-    instructions["seconds"] = vector<Instruction>{
-        Instruction(TokenTypes{ COLON, ARG }, [&](const Arguments& v) {
-            Var& var1 = FindVar(v[0])->second;
-            var1.SetData(duration<double>(high_resolution_clock::now() - start).count());
-        })
+    implementations[OP_SECONDS] = [FindVar, start](const Operands& v) {
+        Var& var1 = FindVar(v[0]);
+        var1.SetData(duration<double>(high_resolution_clock::now() - start).count());
     };
 
-    instructions["delay"] = vector<Instruction>{
-        Instruction(TokenTypes{ COLON, ARG }, [&](const Arguments& v) {
-            const Var& var1 = ResolveValue(v[0]); int nameType = var1.GetType();
+    implementations[OP_DELAY] = [ResolveValue](const Operands& v) {
+        const Var& var1 = ResolveValue(v[0]); int nameType = var1.GetType();
 
-            // If it isn't the same type, or number type.
-            if (nameType != DOUBLE && nameType != INT)
-                throw runtime_error(("Delay received wrong type. Got: '" + IntToType(nameType) + "'").c_str());
+        // If it isn't the same type, or number type.
+        if (nameType != DOUBLE && nameType != INT)
+            throw runtime_error(("Delay received wrong type. Got: '" + IntToType(nameType) + "'").c_str());
 
-            switch (nameType) {
-                case DOUBLE: {
-                    auto val1 = get<double>(var1.GetData());
-                    std::this_thread::sleep_for(milliseconds((int)val1));
-                    break;
-                }
-                case INT: {
-                    auto val1 = get<int>(var1.GetData());
-                    std::this_thread::sleep_for(milliseconds(val1));
-                    break;
-                }
+        switch (nameType) {
+            case DOUBLE: {
+                auto val1 = var1.GetDouble();
+                std::this_thread::sleep_for(milliseconds((int)val1));
+                break;
+            }
+            case INT: {
+                auto val1 = var1.GetInt();
+                std::this_thread::sleep_for(milliseconds(val1));
+                break;
             }
-        })
+        }
     };
 
-    instructions["delete"] = vector<Instruction>{
-        Instruction(TokenTypes{ COLON, ARG }, [&memory, &errorLevel](const Arguments& v) {
-            const string& name = v[0]; errorLevel = 0;
-            const auto it = memory.find(name);
-            if (it == memory.cend()) {
-                errorLevel = 1; return;
-            }
+    implementations[OP_DELETE] = [Delete](const Operands& v) {
+        Delete(v[0]);
+    };
 
-            memory.erase(it);
-        })
+    implementations[OP_JUMP] = [JumpTo](const Operands& v) {
+        JumpTo(v[0]);
     };
 
-    instructions["jump"] = vector<Instruction>{
-        Instruction(TokenTypes{ COLON, ARG }, [&labelMap, &parsedLineIndex](const Arguments& v) {
-            const string& name = v[0];
-            auto iter = labelMap.find(name);
-            if (iter == labelMap.cend())
-                throw runtime_error(("Tried to jump to undefined label. Got: '" + name + "'").c_str());
+    // Calls a label. A call to a function sets up its frame right above the caller's, where the arguments were already bound.
+    // Other labels keep running in the caller's frame
+    auto Call = [&callStack, &memory, &program, &parsedLineIndex, &frameBase, &frameTop, &currentFunction, &argCount, &maxFrameSize, JumpTo](const Operands& v) {
+        callStack.emplace_back(parsedLineIndex, frameBase, frameTop, currentFunction);
+        LS_STAT(GetStats().maxCallDepth = std::max(GetStats().maxCallDepth, callStack.size()));
+
+        const int function = v[1].GetIndex();
+        if (function != -1) {
+            frameBase = frameTop; frameTop += program.GetFunction(function).GetFrameSize(); currentFunction = function;
+            //Keep room above the frame for the arguments of the next call
+            if ((int)memory.size() < frameTop + maxFrameSize)
+                memory.resize(std::max(memory.size() * 2, (size_t)(frameTop + maxFrameSize)), Var::Undefined());
+        }
 
-            // Jump to the new line
-            parsedLineIndex = iter->second;
-        })
+        argCount = 0;
+        JumpTo(v[0]);
     };
 
-    instructions["call"] = std::vector<Instruction>{
-        Instruction(TokenTypes{ COLON, ARG }, [&labelMap, &callHistory, &parsedLineIndex](const Arguments& v) {
-            // Push current line to callHistory
-            callHistory.emplace_back(parsedLineIndex);
-            const string& name = v[0];
-            const auto iter = labelMap.find(name);
-            if (iter == labelMap.cend())
-                throw runtime_error(("Tried to jump to undefined label. Got: '" + name + "'").c_str());
-
-            // Jump to the new line
-            parsedLineIndex = iter->second;
-        })
-    };
+    // Binds the next argument of a call to the next parameter slot, right above the caller's frame
+    auto BindArg = [&memory, &frameTop, &argCount](Var value) {
+        if (frameTop + argCount >= (int)memory.size())
+            throw runtime_error("Call received too many arguments");
 
-    instructions["return"] = vector<Instruction>{
-        Instruction(TokenTypes{}, [&callHistory, FindInstructionA, &parsedLineIndex](const Arguments& v) {
-            // Return is equivalent to exit if the callHistory is empty.
-            if (callHistory.size() < 1)
-                FindInstructionA("exit")(vector<string> { "0" });
-
-            // Set current line to latest entry and remove the entry. 
-            parsedLineIndex = callHistory.back(); callHistory.pop_back();
-        }),
-        // Override: Return a variable
-        Instruction(TokenTypes{ COLON, ARG }, [&callHistory, FindInstructionA, &parsedLineIndex](const Arguments& v) {
-            const string& name = v[0];
-
-            // Push the variable to the stack
-            FindInstructionA("push")(vector<string> { name });
-            // Also delete the function
-            FindInstructionA("delete")(vector<string> { name });
-
-            // Set current line to latest entry and remove the entry. 
-            parsedLineIndex = callHistory.back(); callHistory.pop_back();
-        })
+        memory[frameTop + argCount++] = std::move(value);
     };
 
-    instructions["if"] = vector<Instruction>{
-        Instruction(TokenTypes{ COLON, ARG, LOGIC, ARG, COMMA, ARG }, [&](const Arguments& v) {
-            const Var& var1 = ResolveValue(v[0]), var2 = ResolveValue(v[2]);
-            int value1Type = var1.GetType(), value2Type = var2.GetType();
-
-            // First figure out which exact operator is being used
-            int op = (v[1] == "==") ? 0 : (v[1] == "!=") ? 1 : (v[1] == "<") ? 2 : (v[1] == ">") ? 3 : (v[1] == "<=") ? 4 : (v[1] == ">=") ? 5 : -1;
-
-            if (op == -1)
-                throw std::runtime_error("Invalid operator: " + v[1]);
-            
-            // Check for types. Compare doubles and ints
-            if (value1Type != value2Type && !(value1Type == DOUBLE && value2Type == INT) && !(value1Type == INT && value2Type == DOUBLE))
-                throw std::runtime_error("Comparing different types. Type1: '" + IntToType(value1Type) + "' Type2: '" + IntToType(value2Type) + "'");
-            
-
-            // Handle equality and inequality first
-            if (op == 0 || op == 1) {
-                if (op == 0 && var1.GetData() != var2.GetData())
-                    FindInstructionA("jump")({ v[3] });
-                if (op == 1 && var1.GetData() == var2.GetData())
-                    FindInstructionA("jump")({ v[3] });
-                return;
-            }
+    implementations[OP_CALL] = Call;
 
-            // Make sure strings and bools cannot be compared relationally
-            if (value1Type == STRING || value1Type == BOOL) {
-                throw std::runtime_error("Cannot use relational operators on Type: '" + IntToType(value1Type) + "'");
-            }
+    // Binds the top of the stack, the result of a nested call. Sets errorLevel and leaves the parameter undefined if the stack is empty
+    auto PopArg = [&stack, &errorLevel, &argCount, BindArg](const Operands& v) {
+        errorLevel = 0;
+        if (stack.empty()) {
+            errorLevel = 1; argCount++; return;
+        }
 
-            bool jump = false;
-            if (value1Type == DOUBLE || value1Type == INT) {
-                //Get the values. Taking into account that doubles can be compared to ints.
-                double val1 = (value1Type == DOUBLE) ? get<double>(var1.GetData()) : (double)(get<int>(var1.GetData()));
-                double val2 = (value2Type == DOUBLE) ? get<double>(var2.GetData()) : (double)(get<int>(var2.GetData()));
-
-                // Relational operators
-                switch (op) {
-                    case 2: // <
-                        jump = (val1 >= val2);
-                        break;
-                    case 3: // >
-                        jump = (val1 <= val2);
-                        break;
-                    case 4: // <=
-                        jump = (val1 > val2);
-                        break;
-                    case 5: // >=
-                        jump = (val1 < val2);
-                        break;
-                }
-            }
+        BindArg(std::move(stack.back()));
+        stack.pop_back();
+    };
 
-            // Jump to line if condition isn't met
-            if (jump) 
-                FindInstructionA("jump")({ v[3] });
-        }),
-        // Override: If bool is true or variable is initialized
-        Instruction(TokenTypes{ COLON, ARG, COMMA, ARG }, [&](const Arguments& v) {
-            const Var& var1 = FindVar(v[0])->second; int type = var1.GetType();
-
-            // If the type is bool and it isn't true or if the type is errorType, jump to end
-            if(type == BOOL && !get<bool>(var1.GetData()))
-                FindInstructionA("jump")(vector<string> { v[1] });
-            if(type == ERROR)
-                FindInstructionA("jump")(vector<string> { v[1] });
-        }),
-        // Override: If bool is true or variable is initialized
-        Instruction(TokenTypes{ COLON, NEG, ARG, COMMA, ARG }, [&](const Arguments& v) {
-            const Var& var1 = FindVar(v[0])->second; int type = var1.GetType();
-
-            // If the type is bool and it is true or if the type isn't errorType, jump to end
-            if (type == BOOL && get<bool>(var1.GetData()))
-                FindInstructionA("jump")(vector<string> { v[1] });
-            else if (type != ERROR && type != BOOL)
-                FindInstructionA("jump")(vector<string> { v[1] });
-        })
+    implementations[OP_ARG] = [ResolveValue, BindArg](const Operands& v) {
+        BindArg(ResolveValue(v[0]));
+    };
+    // Overload: Bind the result of a nested call
+    implementations[OP_ARG_POP] = PopArg;
+
+    // Frees the frame of the returning function and continues after the call in the caller's frame
+    auto LeaveFrame = [&callStack, &memory, &parsedLineIndex, &frameBase, &frameTop, &currentFunction]() {
+        const Frame& caller = callStack.back();
+        //A function's frame starts at the caller's top. A called label shares the caller's frame, which must survive
+        if (caller.GetTop() == frameBase)
+            for (int i = frameBase; i < frameTop; i++)
+                memory[i].Release();
+
+        parsedLineIndex = caller.GetReturnIndex(); frameBase = caller.GetBase(); frameTop = caller.GetTop(); currentFunction = caller.GetFunction();
+        callStack.pop_back();
     };
 
-    //Append instruction names to the blacklist
-    for (const auto& a : instructions)
-        blacklist.insert(a.first);
+    auto Return = [&callStack, LeaveFrame, Exit](const Operands& v) {
+        // Return is equivalent to exit if the callStack is empty.
+        if (callStack.empty())
+            Exit(0);
 
-    //Vector storing functions on each line. Int stores real line, vector<string> stores arg, function stores implementation
-    vector<InstructionHandle> instructionVec;
+        LeaveFrame();
+    };
 
-    //Fifth, tokenize each line and go through the actual interpretation process. 
-    for (const auto& [lineNum, l] : parsedLines) {
-        vector<string> tokens;
+    auto ReturnValue = [&callStack, Push, LeaveFrame, Exit](const Operands& v) {
+        // Push the variable to the stack. Its slot is freed along with the frame
+        Push(v[0]);
 
-        //Skip labels
-        if (l[0] == '=') {
-            //Take into consideration that the location labels point to should be kept the same when actually running the function implementations
-            instructionVec.push_back({ -1, Arguments{}, nullptr });
-            continue;
-        }
-        try {
-            tokens = Tokenize(l);
+        if (callStack.empty())
+            Exit(0);
+
+        LeaveFrame();
+    };
+
+    implementations[OP_RETURN] = Return;
+    // Override: Return a variable
+    implementations[OP_RETURN_VALUE] = ReturnValue;
+
+    auto IfCompare = [ResolveValue, JumpTo](const Operands& v) {
+        const Var& var1 = ResolveValue(v[0]); const Var& var2 = ResolveValue(v[2]);
+        int value1Type = var1.GetType(), value2Type = var2.GetType();
+
+        // The operator was decoded when the instruction was compiled
+        const int op = v[1].GetIndex();
+        
+        // Check for types. Compare doubles and ints
+        if (value1Type != value2Type && !(value1Type == DOUBLE && value2Type == INT) && !(value1Type == INT && value2Type == DOUBLE))
+            throw std::runtime_error("Comparing different types. Type1: '" + IntToType(value1Type) + "' Type2: '" + IntToType(value2Type) + "'");
+        
+
+        // Handle equality and inequality first
+        if (op == EQUAL || op == NOT_EQUAL) {
+            if (op == EQUAL && var1 != var2)
+                JumpTo(v[3]);
+            if (op == NOT_EQUAL && var1 == var2)
+                JumpTo(v[3]);
+            return;
         }
-        catch (const std::runtime_error& e) {
-            ExitError(string(e.what()), lineNum);
+
+        // Make sure strings and bools cannot be compared relationally
+        if (value1Type == STRING || value1Type == BOOL) {
+            throw std::runtime_error("Cannot use relational operators on Type: '" + IntToType(value1Type) + "'");
         }
 
-        //Check if semicolon is found
-        if (l.back() != ';') {
-            ExitError("Missing semicolon", lineNum);
+        bool jump = false;
+        if (value1Type == DOUBLE || value1Type == INT) {
+            //Get the values. Taking into account that doubles can be compared to ints.
+            double val1 = (value1Type == DOUBLE) ? var1.GetDouble() : (double)(var1.GetInt());
+            double val2 = (value2Type == DOUBLE) ? var2.GetDouble() : (double)(var2.GetInt());
+
+            // Relational operators
+            switch (op) {
+                case LESS:
+                    jump = (val1 >= val2);
+                    break;
+                case GREATER:
+                    jump = (val1 <= val2);
+                    break;
+                case LESS_EQUAL:
+                    jump = (val1 > val2);
+                    break;
+                case GREATER_EQUAL:
+                    jump = (val1 < val2);
+                    break;
+            }
         }
 
-        string funcName = tokens[0];
+        // Jump to line if condition isn't met
+        if (jump) 
+            JumpTo(v[3]);
+    };
+
+    auto IfTrue = [&program, FindVar, JumpTo](const Operands& v) {
+        const Var& var1 = (v[0].GetKind() == OPERAND_CONSTANT) ? program.GetConstant(v[0].GetIndex()) : FindVar(v[0]);
+        int type = var1.GetType();
+
+        // If the type is bool and it isn't true or if the type is errorType, jump to end
+        if(type == BOOL && !var1.GetBool())
+            JumpTo(v[1]);
+        if(type == ERROR)
+            JumpTo(v[1]);
+    };
+
+    auto IfFalse = [&program, FindVar, JumpTo](const Operands& v) {
+        const Var& var1 = (v[0].GetKind() == OPERAND_CONSTANT) ? program.GetConstant(v[0].GetIndex()) : FindVar(v[0]);
+        int type = var1.GetType();
+
+        // If the type is bool and it is true or if the type isn't errorType, jump to end
+        if (type == BOOL && var1.GetBool())
+            JumpTo(v[1]);
+        else if (type != ERROR && type != BOOL)
+            JumpTo(v[1]);
+    };
+
+    implementations[OP_IF_COMPARE] = IfCompare;
+    // Override: If bool is true or variable is initialized
+    implementations[OP_IF_TRUE] = IfTrue;
+    // Override: If bool is false or variable is uninitialized
+    implementations[OP_IF_FALSE] = IfFalse;
 
-        //If funcName is not a function, perhaps it is an identifier. Prepend [VarName] and set it as the function name. 
-        if (instructions.find(funcName) == instructions.cend()) {
-            tokens.insert(tokens.begin(), "[VarName]"); funcName = "[VarName]";
+    //Append instruction names to the blacklist
+    for (const InstructionSignature& overload : instructionSignatures)
+        blacklist.insert(string(overload.name));
+    //The end of the program has no instruction name, it is appended after compiling
+    implementations[OP_HALT] = [Exit](const Operands& v) {
+        Exit(0);
+    };
+    //Specialized instructions share the implementation of the generic instruction they were made from
+    for (int opcode = OP_HALT + 1; opcode < OPCODE_COUNT; opcode++)
+        implementations[opcode] = implementations[GetGenericOpcode(opcode)];
+
+    //Vector storing the compiled instructions. Labels stay in place as no-ops so label indices remain valid
+    vector<InstructionHandle>& instructionVec = program.GetCode();
+
+    //Fifth, resolve the instruction overload each lowered statement calls, then compile it.
+    //Decodes the name and arguments of the instruction a statement calls. As TokenTypes SET and below are unambiguous, they are not arguments
+    auto DecodeStatement = [&lowered](const LoweredStatement& statement, string& funcName, vector<string>& args, TokenTypes& argTypes) {
+        funcName = statement.name; args.clear(); argTypes.clear();
+        for (const Token& token : lowered.GetTokens(statement)) {
+            argTypes.push_back(token.type);
+            if (token.type == ARG || token.type > SET)
+                args.emplace_back(token.text);
         }
 
-        vector<string> args; TokenTypes argTypes;
-        //For each token, check its opType and push it back to the vector
-        for (int i = 1; i < tokens.size() - 1; i++) {
-            string token = tokens[i];
-            //Token is not a seperator, therefore it is an argument
-            auto found = separators.find(token);
-            if (found == separators.cend()) {
-                args.push_back(token); argTypes.push_back(ARG);
-            }
-            //Token is a seperator and has a corresponding OpType
-            else {
-                int argType = (*found).second;
-                argTypes.push_back(argType);
-                //As TokenTypes SET and below are unambiguous, do not push them
-                if (argType > SET)
-                    args.push_back(token);
+        //If the name is not an instruction, perhaps it is an identifier. Prepend it as an argument and set [VarName] as the function name.
+        if (!IsInstructionName(funcName)) {
+            const int type = ClassifyToken(funcName);
+            argTypes.insert(argTypes.begin(), type);
+            if (type == ARG || type > SET)
+                args.insert(args.begin(), funcName);
+            funcName = "[VarName]";
+        }
+    };
+
+    //Returns: Opcode of the overload a decoded statement calls
+    auto ResolveStatement = [FindInstruction, ValidateVarName](const string& funcName, const vector<string>& args, const TokenTypes& argTypes) {
+        const int opcode = FindInstruction(funcName, argTypes);
+        //Declarations always name a slot, so their names are validated here rather than on every run
+        if (opcode == OP_VAR || opcode == OP_VAR_DECLARE)
+            ValidateVarName(args[0]);
+        return opcode;
+    };
+
+    //Resolving only reads the instructions, so jobs resolve ranges of statements in parallel. Statements that fail are left at -1
+    //and resolved again below, where the error is reported in order
+    vector<int> opcodes(lowered.statements.size(), -1);
+    RunJobs(CountJobs(jobs, lowered.statements.size(), 1 << 12), lowered.statements.size(), [&](const size_t& begin, const size_t& end) {
+        string funcName; vector<string> args; TokenTypes argTypes;
+        for (size_t i = begin; i < end; i++) {
+            if (lowered.statements[i].isLabel) continue;
+            DecodeStatement(lowered.statements[i], funcName, args, argTypes);
+            try {
+                opcodes[i] = ResolveStatement(funcName, args, argTypes);
             }
+            catch (const std::runtime_error&) {}
         }
+    });
+
+    //Compiling adds to the constant pool and identifier table in order, so it stays sequential
+    string funcName; vector<string> args; TokenTypes argTypes;
+    for (size_t index = 0; index < lowered.statements.size(); index++) {
+        const LoweredStatement& statement = lowered.statements[index];
+        const int lineNum = statement.line;
+        //Take into consideration that the location labels point to should be kept the same when actually running the function implementations
+        if (statement.isLabel) {
+            instructionVec.push_back(InstructionHandle());
+            continue;
+        }
+
+        DecodeStatement(statement, funcName, args, argTypes);
 
-        //Store the instruction in the instruction vector
+        //Compile the instruction: decode every argument once, so execution never parses text again
         try {
-            auto foundImplementation = FindInstruction(funcName, argTypes);
-            instructionVec.push_back({ lineNum, args, foundImplementation });
+            const int opcode = opcodes[index] != -1 ? opcodes[index] : ResolveStatement(funcName, args, argTypes);
+
+            Operands operands;
+            for (int i = 0; i < (int)args.size(); i++)
+                operands.Push(CompileOperand(args[i], IsLabelOperand(opcode, i, (int)args.size())));
+
+            instructionVec.push_back(InstructionHandle(lineNum, opcode, operands));
         }
         catch (const std::runtime_error& e) {
             //Specialized error message for [VarName] as it indicates a non-instruction funcName
             if (funcName == "[VarName]")
-                ExitError("No Instruction or identifier by the name '" + tokens[1] + "' found", lineNum);
+                ExitError("No Instruction or identifier by the name '" + string(statement.name) + "' found", lineNum);
             ExitError(string(e.what()), lineNum);
         }
     }
 
-    //Execute the functions
-    for (; parsedLineIndex < instructionVec.size(); parsedLineIndex++) {
-        //If parsedLineIndex is on the latest call, delete it to avoid duplicate calls. 
-        if (!callHistory.empty() && callHistory.back() == parsedLineIndex)
-            callHistory.erase(callHistory.begin() + parsedLineIndex);
+    //A cached program was stored once the steps below were done, so it starts out here
+    if (!cached) {
+        //Sixth, resolve the variables of every function to slots in its frame. Parameters and variables declared within the function
+        //are local to it, every other identifier stays global
+        for (FunctionScope& function : program.GetFunctions()) {
+            //Collect the declarations first, so uses before the declaration are local too
+            for (int i = function.GetBegin(); i < function.GetEnd(); i++) {
+                const InstructionHandle& instruction = instructionVec[i];
+                if (instruction.GetOpcode() == OP_VAR || instruction.GetOpcode() == OP_VAR_DECLARE)
+                    function.AddLocal(program.GetIdentifier(instruction.GetOperands()[0].GetIndex()));
+            }
 
-        int lineNum = instructionVec[parsedLineIndex].GetLine();
+            for (int i = function.GetBegin(); i < function.GetEnd(); i++) {
+                Operands operands = instructionVec[i].GetOperands();
+                for (int j = 0; j < operands.Size(); j++) {
+                    if (operands[j].GetKind() != OPERAND_VARIABLE)
+                        continue;
+                    const int slot = function.FindLocal(program.GetIdentifier(operands[j].GetIndex()));
+                    if (slot != -1)
+                        operands[j] = Operand(OPERAND_LOCAL, slot);
+                }
+                instructionVec[i].SetOperands(operands);
+            }
+        }
 
-        //Label
-        if (lineNum == -1)
-            continue;
+        //Every call also gets the function it enters, which decides the frame it sets up
+        for (InstructionHandle& instruction : instructionVec) {
+            if (instruction.GetOpcode() != OP_CALL)
+                continue;
+            Operands operands = instruction.GetOperands();
+            operands.Push(Operand(OPERAND_FUNCTION, program.FindFunction(operands[0].GetIndex())));
+            instruction.SetOperands(operands);
+        }
+
+        //Mark the end of the program, so both engines stop through the same exit path
+        instructionVec.push_back(InstructionHandle(lowered.statements.empty() ? 0 : lowered.statements.back().line, OP_HALT, Operands()));
+
+        //Cache the compiled program before the passes, so it serves every engine and option
+        if (useCache)
+            SaveProgram(program, cachePath, sourceHash);
+    }
+    maxFrameSize = program.GetMaxFrameSize();
+
+    //Work out what is known at load time and drop the code that can never run. Both engines run the result.
+    //--dump-ir prints the program before and after the passes to stderr
+    if (dumpIR)
+        DumpProgram(program, std::cerr, "compiled");
+
+    PropagateConstants(program);
+    FoldConstants(program);
+    EliminateDeadCode(program);
+
+    //Prove the types of the operands that never change. An instruction that can only fail on them is reported before anything runs
+    const vector<OperandTypes> provenTypes = InferTypes(program, SlotTable(program));
+    string typeError; const int failing = FindTypeError(program, provenTypes, typeError);
+    if (failing != -1)
+        ExitError(typeError, instructionVec[failing].GetLine());
+
+    //The dispatch engine runs comparisons and arithmetic as opcodes specialized for the types their operands are proven or predicted to hold.
+    //It also runs without the label entries and with common loop sequences fused into superinstructions
+    if (!useLambdaEngine || !emitPath.empty())
+        SpecializeInstructions(program, provenTypes);
+
+    //--emit-cpp writes the specialized program as a C++ translation unit instead of running it
+    if (!emitPath.empty()) {
+        std::ofstream emitted(emitPath);
+        if (!emitted.is_open())
+            ExitError("Cannot open '" + emitPath + "' for writing");
+        EmitCpp(program, emitted, path);
+        return 0;
+    }
+
+    if (!useLambdaEngine) {
+        DropLabels(program);
+        FuseInstructions(program);
+    }
+
+    if (dumpIR)
+        DumpProgram(program, std::cerr, "optimized");
+
+    //Allocate one memory slot per global identifier, plus room for the arguments of the first call.
+    //Slots stay undefined until a 'var' or 'pop' defines them
+    memory.assign(program.GetIdentifierCount() + maxFrameSize, Var::Undefined());
+    frameBase = frameTop = program.GetIdentifierCount();
+
+    //Fallback engine: look up each implementation by opcode and call it through std::function
+    auto RunLambdas = [&]() {
+        for (; parsedLineIndex < (int)instructionVec.size(); parsedLineIndex++) {
+            const InstructionHandle& instruction = instructionVec[parsedLineIndex];
+            LS_STAT(stats.executed[parsedLineIndex]++);
+
+            //Label
+            if (instruction.GetOpcode() == OP_LABEL)
+                continue;
+
+            try {
+                //Dispatch on the opcode and pass in the decoded operands
+                implementations[instruction.GetOpcode()](instruction.GetOperands());
+            }
+            catch (const std::runtime_error& e) {
+                ExitError(e.what(), instruction.GetLine());
+            }
+        }
+    };
+
+    //Default engine: a dispatch loop over the opcodes. Handlers call the implementations directly, so they can be inlined.
+    //With GCC and Clang every handler jumps straight to the next one through a table of label addresses (direct threading),
+    //other compilers get a switch in a loop.
+    auto RunDispatch = [&]() {
+        InstructionHandle* code = instructionVec.data();
+        int& pc = parsedLineIndex;
+
+        //The globals and the running frame, cached across handlers. Only calls and returns move the frame or grow the memory
+        Var* globals = memory.data(); Var* frame = globals + frameBase;
+
+        //--stats counts every instruction dispatched, in builds with statistics
+#ifdef LS_STATS
+        uint64_t* const executed = stats.executed.data();
+#define COUNT_INSTRUCTION() executed[pc]++
+#else
+#define COUNT_INSTRUCTION()
+#endif
+
+#ifdef LS_COMPUTED_GOTO
+#define LS_DISPATCH_LABEL(name) &&name##_HANDLER,
+        static void* const dispatchTable[OPCODE_COUNT] = { LS_OPCODES(LS_DISPATCH_LABEL) };
+#undef LS_DISPATCH_LABEL
+        //NEXT goes through the recording table while the JIT records a loop, REDISPATCH always runs the handler itself
+        void* const* dispatch = dispatchTable;
+#define HANDLER(name) name##_HANDLER
+#define NEXT() ++pc; COUNT_INSTRUCTION(); goto *dispatch[code[pc].GetOpcode()]
+#define REDISPATCH() goto *dispatchTable[code[pc].GetOpcode()]
+#else
+#define HANDLER(name) case name
+#define NEXT() ++pc; continue
+#define REDISPATCH() continue
+#endif
+#ifdef LS_JIT
+        //With --jit every backward jump lets the JIT count the loop, record an iteration of it or run its trace
+#define LS_RECORD_LABEL(name) &&RECORD_HANDLER,
+        static void* const recordTable[OPCODE_COUNT] = { LS_OPCODES(LS_RECORD_LABEL) };
+#undef LS_RECORD_LABEL
+        std::unique_ptr<TraceJit> jit;
+        if (useJit)
+            jit = std::make_unique<TraceJit>(program);
+#define LOOP_NEXT() \
+                ++pc; \
+                if (jit) { \
+                    const int next = jit->OnLoop(pc, globals, frame); \
+                    if (next == TraceJit::RECORD) \
+                        dispatch = recordTable; \
+                    else if (next != TraceJit::INTERPRET) \
+                        pc = next; \
+                } \
+                COUNT_INSTRUCTION(); \
+                goto *dispatch[code[pc].GetOpcode()]
+#else
+#define LOOP_NEXT() NEXT()
+#endif
+#define OPERANDS code[pc].GetOperands()
+//Memory slot and value of an operand without any checks. The type guards of the specialized handlers reject undefined variables.
+//These are macros rather than lambdas, as the compiler stops inlining calls into a function this large
+#define SLOT(operand) (((operand).GetKind() == OPERAND_LOCAL ? frame : globals)[(operand).GetIndex()])
+#define VALUE_OF(operand) (*((operand).GetKind() == OPERAND_CONSTANT ? &program.GetConstant((operand).GetIndex()) : &SLOT(operand)))
+#define RELOAD_FRAME() globals = memory.data(); frame = globals + frameBase
+//A specialized instruction whose operands no longer have the predicted types is rewritten into its generic instruction for good
+#define DEOPTIMIZE() code[pc].SetOpcode(GetGenericOpcode(code[pc].GetOpcode())); REDISPATCH()
+//Every specialized handler comes in two forms: one that guards the types of its operands, and an unchecked one for operands
+//whose types were proven at load time. The guard is passed in as the last argument of the bodies
+#define TYPE_GUARD(condition) if (condition) { DEOPTIMIZE(); }
+//Jumps to the end of the if statement unless val1 op val2 holds
+#define COMPARE_BODY(name, get1, get2, op, guard) \
+                HANDLER(name): { \
+                    const Var& var1 = VALUE_OF(OPERANDS[0]); const Var& var2 = VALUE_OF(OPERANDS[2]); \
+                    guard \
+                    if (!(var1.get1() op var2.get2())) \
+                        pc = OPERANDS[3].GetIndex(); \
+                    NEXT(); \
+                }
+#define COMPARE_HANDLER(name, type1, type2, get1, get2, op) \
+                COMPARE_BODY(name, get1, get2, op, TYPE_GUARD(var1.GetType() != type1 || var2.GetType() != type2)) \
+                COMPARE_BODY(name##_UNCHECKED, get1, get2, op, )
+//Sets the variable to var1 op val2, after the check in front of it
+#define ARITHMETIC_BODY(name, get1, get2, op, check, guard) \
+                HANDLER(name): { \
+                    Var& var1 = SLOT(OPERANDS[0]); const Var& var2 = VALUE_OF(OPERANDS[2]); \
+                    guard \
+                    check \
+                    var1.SetData(var1.get1() op var2.get2()); \
+                    NEXT(); \
+                }
+#define ARITHMETIC_HANDLER(name, type1, type2, get1, get2, op, check) \
+                ARITHMETIC_BODY(name, get1, get2, op, check, TYPE_GUARD(var1.GetType() != type1 || var2.GetType() != type2)) \
+                ARITHMETIC_BODY(name##_UNCHECKED, get1, get2, op, check, )
+#define STEP_BODY(name, get, step, guard) \
+                HANDLER(name): { \
+                    Var& var1 = SLOT(OPERANDS[0]); \
+                    guard \
+                    var1.SetData(var1.get() + step); \
+                    NEXT(); \
+                }
+#define STEP_HANDLER(name, type, get, step) \
+                STEP_BODY(name, get, step, TYPE_GUARD(var1.GetType() != type)) \
+                STEP_BODY(name##_UNCHECKED, get, step, )
+//i++; jump: FOR_n; followed by the loop condition 'if: i op x, END_n;' right after the label
+#define LOOP_BODY(name, op, guard) \
+                HANDLER(name): { \
+                    Var& var1 = SLOT(OPERANDS[0]); \
+                    const Operands& condition = code[OPERANDS[2].GetIndex() + 1].GetOperands(); const Var& var2 = VALUE_OF(condition[2]); \
+                    guard \
+                    var1.SetData(var1.GetInt() + 1); \
+                    if (var1.GetInt() op var2.GetInt()) { \
+                        pc = OPERANDS[2].GetIndex() + 1; \
+                        LOOP_NEXT(); \
+                    } \
+                    pc = condition[3].GetIndex(); \
+                    NEXT(); \
+                }
+#define LOOP_HANDLER(name, op) \
+                LOOP_BODY(name, op, TYPE_GUARD(var1.GetType() != INT || var2.GetType() != INT)) \
+                LOOP_BODY(name##_UNCHECKED, op, )
+#define DIVISION_CHECK if (var2.GetType() == INT ? var2.GetInt() == 0 : var2.GetDouble() == 0.0) throw runtime_error("Division by 0 attempted");
+#define MODULO_CHECK if (var2.GetInt() == 0) throw runtime_error("Modulo by 0 attempted");
 
         try {
-            //Get the function implementation and pass in the args. Index 2 and 1 respectively
-            instructionVec[parsedLineIndex].Execute();
+#ifdef LS_COMPUTED_GOTO
+            COUNT_INSTRUCTION();
+            goto *dispatchTable[code[pc].GetOpcode()];
+#else
+            for (;;) {
+                COUNT_INSTRUCTION();
+                switch (code[pc].GetOpcode()) {
+#endif
+                HANDLER(OP_LABEL):
+                    NEXT();
+                HANDLER(OP_PRINT):
+                    Print(ResolveValue(OPERANDS[0]));
+                    NEXT();
+                HANDLER(OP_PRINTL):
+                    Print(ResolveValue(OPERANDS[0])); output.Write('\n');
+                    NEXT();
+                HANDLER(OP_ENDL):
+                    output.Write('\n');
+                    NEXT();
+                HANDLER(OP_PUSH):
+                    Push(OPERANDS[0]);
+                    NEXT();
+                HANDLER(OP_POP): {
+                    //Popping into a variable of the type on top of the stack needs none of the checks of PopVar
+                    const Operand& operand = OPERANDS[0];
+                    if (!stack.empty() && (operand.GetKind() == OPERAND_VARIABLE || operand.GetKind() == OPERAND_LOCAL)) {
+                        Var& var1 = SLOT(operand);
+                        if (var1.GetType() == stack.back().GetType()) {
+                            errorLevel = 0; var1 = std::move(stack.back()); stack.pop_back();
+                            NEXT();
+                        }
+                    }
+                    PopVar(OPERANDS);
+                    NEXT();
+                }
+                HANDLER(OP_VAR):
+                    DeclareVar(OPERANDS);
+                    NEXT();
+                HANDLER(OP_VAR_DECLARE):
+                    DeclareEmptyVar(OPERANDS);
+                    NEXT();
+                HANDLER(OP_EXIT):
+                    ExitInstruction(OPERANDS);
+                    NEXT();
+                HANDLER(OP_SET):
+                    Assign(OPERANDS);
+                    NEXT();
+                HANDLER(OP_MODIFY):
+                    Modify(OPERANDS);
+                    NEXT();
+                HANDLER(OP_STEP):
+                    Step(OPERANDS);
+                    NEXT();
+                HANDLER(OP_APPEND):
+                    Append(OPERANDS);
+                    NEXT();
+                HANDLER(OP_SQRT):
+                    SquareRoot(OPERANDS);
+                    NEXT();
+                HANDLER(OP_DELETE):
+                    Delete(OPERANDS[0]);
+                    NEXT();
+                HANDLER(OP_JUMP):
+                    if (OPERANDS[0].GetIndex() < pc) {
+                        pc = OPERANDS[0].GetIndex();
+                        LOOP_NEXT();
+                    }
+                    pc = OPERANDS[0].GetIndex();
+                    NEXT();
+                //Calls, arguments and returns are spelled out rather than calling Call, BindArg and LeaveFrame, for the same reason as SLOT
+                HANDLER(OP_CALL): {
+                    const int function = OPERANDS[1].GetIndex();
+                    callStack.emplace_back(pc, frameBase, frameTop, currentFunction);
+                    LS_STAT(stats.maxCallDepth = std::max(stats.maxCallDepth, callStack.size()));
+                    if (function != -1) {
+                        frameBase = frameTop; frameTop += program.GetFunction(function).GetFrameSize(); currentFunction = function;
+                        if ((int)memory.size() < frameTop + maxFrameSize)
+                            memory.resize(std::max(memory.size() * 2, (size_t)(frameTop + maxFrameSize)), Var::Undefined());
+                    }
+
+                    argCount = 0; pc = OPERANDS[0].GetIndex();
+                    RELOAD_FRAME();
+                    NEXT();
+                }
+                HANDLER(OP_ARG): {
+                    const Operand& operand = OPERANDS[0];
+                    const Var& value = VALUE_OF(operand);
+                    //Undefined arguments and surplus ones take the checked path, which reports them
+                    if (!value.IsDefined() || value.GetType() == ERROR || frameTop + argCount >= (int)memory.size())
+                        BindArg(ResolveValue(operand));
+                    globals[frameTop + argCount++] = value;
+                    NEXT();
+                }
+                HANDLER(OP_ARG_POP):
+                    PopArg(OPERANDS);
+                    NEXT();
+                HANDLER(OP_RETURN_VALUE):
+                    //Pushes the value, then returns like OP_RETURN. Undefined values take the checked path, which reports them
+                    {
+                        const Var& value = VALUE_OF(OPERANDS[0]);
+                        if (value.IsDefined() && value.GetType() != ERROR) {
+                            stack.push_back(value);
+                            LS_STAT(stats.maxStack = std::max(stats.maxStack, stack.size()));
+                        }
+                        else
+                            Push(OPERANDS[0]);
+                    }
+                HANDLER(OP_RETURN): {
+                    if (callStack.empty())
+                        Exit(0);
+
+                    const Frame& caller = callStack.back();
+                    if (caller.GetTop() == frameBase)
+                        for (int i = frameBase; i < frameTop; i++)
+                            globals[i].Release();
+
+                    pc = caller.GetReturnIndex(); frameBase = caller.GetBase(); frameTop = caller.GetTop(); currentFunction = caller.GetFunction();
+                    callStack.pop_back();
+                    RELOAD_FRAME();
+                    NEXT();
+                }
+                HANDLER(OP_IF_COMPARE):
+                    IfCompare(OPERANDS);
+                    NEXT();
+                HANDLER(OP_IF_TRUE):
+                    IfTrue(OPERANDS);
+                    NEXT();
+                HANDLER(OP_IF_FALSE):
+                    IfFalse(OPERANDS);
+                    NEXT();
+                HANDLER(OP_HALT):
+                    Exit(0);
+                    NEXT();
+                //Rarely executed instructions go through the implementation table
+                HANDLER(OP_CLS):
+                HANDLER(OP_FLUSH):
+                HANDLER(OP_INPUT):
+                HANDLER(OP_INPUT_PROMPT):
+                HANDLER(OP_READ):
+                HANDLER(OP_POP_CLEAR):
+                HANDLER(OP_ABS):
+                HANDLER(OP_RAND):
+                HANDLER(OP_MILLIS):
+                HANDLER(OP_SECONDS):
+                HANDLER(OP_DELAY):
+                    implementations[code[pc].GetOpcode()](OPERANDS);
+                    NEXT();
+                //Instructions specialized at load time
+                COMPARE_HANDLER(OP_IF_EQ_INT_INT, INT, INT, GetInt, GetInt, ==)
+                COMPARE_HANDLER(OP_IF_NE_INT_INT, INT, INT, GetInt, GetInt, !=)
+                COMPARE_HANDLER(OP_IF_LT_INT_INT, INT, INT, GetInt, GetInt, <)
+                COMPARE_HANDLER(OP_IF_GT_INT_INT, INT, INT, GetInt, GetInt, >)
+                COMPARE_HANDLER(OP_IF_LE_INT_INT, INT, INT, GetInt, GetInt, <=)
+                COMPARE_HANDLER(OP_IF_GE_INT_INT, INT, INT, GetInt, GetInt, >=)
+                COMPARE_HANDLER(OP_IF_EQ_DBL_DBL, DOUBLE, DOUBLE, GetDouble, GetDouble, ==)
+                COMPARE_HANDLER(OP_IF_NE_DBL_DBL, DOUBLE, DOUBLE, GetDouble, GetDouble, !=)
+                COMPARE_HANDLER(OP_IF_LT_DBL_DBL, DOUBLE, DOUBLE, GetDouble, GetDouble, <)
+                COMPARE_HANDLER(OP_IF_GT_DBL_DBL, DOUBLE, DOUBLE, GetDouble, GetDouble, >)
+                COMPARE_HANDLER(OP_IF_LE_DBL_DBL, DOUBLE, DOUBLE, GetDouble, GetDouble, <=)
+                COMPARE_HANDLER(OP_IF_GE_DBL_DBL, DOUBLE, DOUBLE, GetDouble, GetDouble, >=)
+                COMPARE_HANDLER(OP_IF_LT_INT_DBL, INT, DOUBLE, GetInt, GetDouble, <)
+                COMPARE_HANDLER(OP_IF_GT_INT_DBL, INT, DOUBLE, GetInt, GetDouble, >)
+                COMPARE_HANDLER(OP_IF_LE_INT_DBL, INT, DOUBLE, GetInt, GetDouble, <=)
+                COMPARE_HANDLER(OP_IF_GE_INT_DBL, INT, DOUBLE, GetInt, GetDouble, >=)
+                COMPARE_HANDLER(OP_IF_LT_DBL_INT, DOUBLE, INT, GetDouble, GetInt, <)
+                COMPARE_HANDLER(OP_IF_GT_DBL_INT, DOUBLE, INT, GetDouble, GetInt, >)
+                COMPARE_HANDLER(OP_IF_LE_DBL_INT, DOUBLE, INT, GetDouble, GetInt, <=)
+                COMPARE_HANDLER(OP_IF_GE_DBL_INT, DOUBLE, INT, GetDouble, GetInt, >=)
+                ARITHMETIC_HANDLER(OP_ADD_INT_INT, INT, INT, GetInt, GetInt, +, )
+                ARITHMETIC_HANDLER(OP_SUB_INT_INT, INT, INT, GetInt, GetInt, -, )
+                ARITHMETIC_HANDLER(OP_MUL_INT_INT, INT, INT, GetInt, GetInt, *, )
+                ARITHMETIC_HANDLER(OP_DIV_INT_INT, INT, INT, GetInt, GetInt, /, DIVISION_CHECK)
+                ARITHMETIC_HANDLER(OP_MOD_INT_INT, INT, INT, GetInt, GetInt, %, MODULO_CHECK)
+                ARITHMETIC_HANDLER(OP_ADD_DBL_DBL, DOUBLE, DOUBLE, GetDouble, GetDouble, +, )
+                ARITHMETIC_HANDLER(OP_SUB_DBL_DBL, DOUBLE, DOUBLE, GetDouble, GetDouble, -, )
+                ARITHMETIC_HANDLER(OP_MUL_DBL_DBL, DOUBLE, DOUBLE, GetDouble, GetDouble, *, )
+                ARITHMETIC_HANDLER(OP_DIV_DBL_DBL, DOUBLE, DOUBLE, GetDouble, GetDouble, /, DIVISION_CHECK)
+                ARITHMETIC_HANDLER(OP_ADD_DBL_INT, DOUBLE, INT, GetDouble, GetInt, +, )
+                ARITHMETIC_HANDLER(OP_SUB_DBL_INT, DOUBLE, INT, GetDouble, GetInt, -, )
+                ARITHMETIC_HANDLER(OP_MUL_DBL_INT, DOUBLE, INT, GetDouble, GetInt, *, )
+                ARITHMETIC_HANDLER(OP_DIV_DBL_INT, DOUBLE, INT, GetDouble, GetInt, /, DIVISION_CHECK)
+                STEP_HANDLER(OP_INC_INT, INT, GetInt, 1)
+                STEP_HANDLER(OP_DEC_INT, INT, GetInt, -1)
+                STEP_HANDLER(OP_INC_DBL, DOUBLE, GetDouble, 1.0)
+                STEP_HANDLER(OP_DEC_DBL, DOUBLE, GetDouble, -1.0)
+                //Superinstructions, each replacing the first instruction of a fused sequence
+                LOOP_HANDLER(OP_INC_INT_LOOP_LT, <)
+                LOOP_HANDLER(OP_INC_INT_LOOP_LE, <=)
+                HANDLER(OP_SET_MOD_IF_ZERO): {
+                    //x = y; x %= z; if: x == 0, END;
+                    Var& var1 = SLOT(OPERANDS[0]); const Var& var2 = VALUE_OF(OPERANDS[1]); const Var& var3 = VALUE_OF(OPERANDS[2]);
+                    if (!var1.IsDefined() || var2.GetType() != INT || var3.GetType() != INT || var3.GetInt() == 0) { DEOPTIMIZE(); }
+                    const int value = var2.GetInt() % var3.GetInt();
+                    var1.SetData(value);
+                    pc = value == 0 ? pc + 2 : OPERANDS[3].GetIndex();
+                    NEXT();
+                }
+#ifdef LS_JIT
+                //Every instruction goes through here while the JIT records a loop
+                RECORD_HANDLER:
+                    if (!jit->Record(pc, globals, frame))
+                        dispatch = dispatchTable;
+                    REDISPATCH();
+#endif
+#ifndef LS_COMPUTED_GOTO
+                default:
+                    NEXT();
+                }
+            }
+#endif
         }
         catch (const std::runtime_error& e) {
-            ExitError(e.what(), lineNum);
+            ExitError(e.what(), code[pc].GetLine());
         }
-    }
 
-    //Use the actual exit instruction to exit. Effectively saving 3 lines of code lol
-    FindInstructionA("exit")( Arguments{ "0" });
+#undef HANDLER
+#undef NEXT
+#undef REDISPATCH
+#undef LOOP_NEXT
+#undef OPERANDS
+#undef RELOAD_FRAME
+#undef SLOT
+#undef VALUE_OF
+#undef DEOPTIMIZE
+#undef TYPE_GUARD
+#undef COMPARE_BODY
+#undef COMPARE_HANDLER
+#undef ARITHMETIC_BODY
+#undef ARITHMETIC_HANDLER
+#undef STEP_BODY
+#undef STEP_HANDLER
+#undef LOOP_BODY
+#undef LOOP_HANDLER
+#undef DIVISION_CHECK
+#undef MODULO_CHECK
+#undef COUNT_INSTRUCTION
+    };
+
+    LS_STAT(stats.executed.assign(instructionVec.size(), 0); EndPhase(PHASE_COMPILE, phaseStart));
+
+    //--profile samples the running instruction until the program exits
+#ifdef LS_PROFILE_SUPPORTED
+    if (profile)
+        profiler.Start(parsedLineIndex, callStack);
+#endif
+
+    //Execute the compiled instructions
+    if (useLambdaEngine)
+        RunLambdas();
+    else
+        RunDispatch();
+
+    //Use the actual exit implementation to exit. Effectively saving 3 lines of code lol
+    Exit(0);
 
     file.close();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,85 @@
+// Measures reading integers from stdin: the line by line loop of input against the block reads of read.
+// Build: g++ -std=c++20 -O2 -I LSInterpreter -o input_bench bench/InputBench.cpp
+// Usage: input_bench [numbers.txt] | Without a file, 10M integers are generated into input_bench.txt, one per line.
+// Both loops read the file as their stdin
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include "Runtime.h"
+
+using std::chrono::high_resolution_clock; using std::chrono::duration;
+
+//The loop of input: a getline from cin, the type of the line, then its value
+long long ReadWithGetline(size_t& count) {
+    long long total = 0; Var var1(0); string s;
+    count = 0;
+    while (std::getline(std::cin, s)) {
+        if (GetDataType(s) != INT)
+            continue;
+        var1.SetData(fast_stoi(s));
+        total += var1.GetInt(); count++;
+    }
+    return total;
+}
+
+//The loop of read: fields parsed straight from the block
+long long ReadWithFields(size_t& count) {
+    long long total = 0; Var var1(0); Input input(stdin);
+    count = 0;
+    while (true) {
+        const int result = input.Read(var1);
+        if (result == INPUT_END)
+            break;
+        if (result != INPUT_READ)
+            continue;
+        total += var1.GetInt(); count++;
+    }
+    return total;
+}
+
+int main(int argc, char* argv[]) {
+    string path = "input_bench.txt";
+    if (argc > 1)
+        path = argv[1];
+    else {
+        std::mt19937 random(1);
+        std::uniform_int_distribution<int> values(-1'000'000, 1'000'000);
+        FILE* file = std::fopen(path.c_str(), "w");
+        for (int i = 0; i < 10'000'000; i++)
+            std::fprintf(file, "%d\n", values(random));
+        std::fclose(file);
+    }
+
+    //Every run reads the whole input again from the start
+    auto Time = [&path](const auto& read, size_t& readCount, long long& total) {
+        const int runs = 3; double best = 0.0;
+        for (int run = 0; run < runs; run++) {
+            if (!std::freopen(path.c_str(), "r", stdin)) {
+                std::cerr << "Cannot open " << path << std::endl; std::exit(1);
+            }
+            std::cin.clear();
+
+            auto start = high_resolution_clock::now();
+            total = read(readCount);
+            const double seconds = duration<double>(high_resolution_clock::now() - start).count();
+            if (run == 0 || seconds < best)
+                best = seconds;
+        }
+        return best;
+    };
+
+    size_t getlineCount = 0, fieldCount = 0; long long getlineTotal = 0, fieldTotal = 0;
+    const double getline = Time(ReadWithGetline, getlineCount, getlineTotal);
+    const double fields = Time(ReadWithFields, fieldCount, fieldTotal);
+    if (getlineCount != fieldCount || getlineTotal != fieldTotal) {
+        std::cerr << "The loops read different values" << std::endl; return 1;
+    }
+
+    std::cout << "integers:          " << fieldCount << "\n"
+              << "input (best of 3): " << getline * 1000.0 << " ms, " << (size_t)(getlineCount / getline) << " ints/sec\n"
+              << "read (best of 3):  " << fields * 1000.0 << " ms, " << (size_t)(fieldCount / fields) << " ints/sec\n"
+              << "speedup:           " << getline / fields << "x" << std::endl;
+    return 0;
+}
@@ -0,0 +1,85 @@
+// Measures the throughput of the lexer: Parse and Tokenize over every line of a multi-MB script.
+// Build: g++ -std=c++20 -O2 -I LSInterpreter -o lex_bench bench/LexBench.cpp
+// Usage: lex_bench [script.ls] | Without a script, one of about 8 MB is generated from typical lines
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Parse.h"
+
+using std::chrono::high_resolution_clock; using std::chrono::duration;
+
+//Returns: A script of at least size bytes, made of the statements the examples use most
+string GenerateScript(const size_t& size) {
+    const vector<string> lines = {
+        "func FizzBuzz(number, limit) {",
+        "\tfor (i = 1, i <= number, i++) {",
+        "\t\tvar result = \"\"; modulo = i; modulo %= 15; # Comments are skipped",
+        "\t\tif (modulo == 0) {",
+        "\t\t\tprintl: \"FizzBuzz; or not\"; continue;",
+        "\t\t}",
+        "\t\tFizzBuzz(i, limit) >> result; print: result; endl;",
+        "\t}",
+        "}",
+        "var approximation = 0.0; var total = 0; total += 3; total -= 1;",
+        "while (total < 10000) {",
+        "\ttotal *= 2; if: total >= 4, END_1; jump: LOOP_1;",
+        "}",
+        "=LOOP_1;",
+    };
+
+    string script;
+    while (script.size() < size)
+        for (const string& line : lines)
+            script += line + "\n";
+    return script;
+}
+
+int main(int argc, char* argv[]) {
+    string script;
+    if (argc > 1) {
+        std::ifstream file(argv[1]);
+        if (!file.is_open()) {
+            std::cerr << "Cannot open " << argv[1] << std::endl; return 1;
+        }
+        script.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    else
+        script = GenerateScript(8 << 20);
+
+    //Split the script into lines up front, so only the lexer is timed
+    vector<std::string_view> lines;
+    for (size_t begin = 0; begin < script.size(); ) {
+        size_t end = script.find('\n', begin);
+        if (end == string::npos) end = script.size();
+        lines.push_back(std::string_view(script).substr(begin, end - begin));
+        begin = end + 1;
+    }
+
+    const int runs = 5; double best = 0.0; size_t tokenCount = 0; vector<std::string_view> statements; Tokens tokens;
+    for (int run = 0; run < runs; run++) {
+        tokenCount = 0;
+        auto start = high_resolution_clock::now();
+        for (const std::string_view& line : lines) {
+            Parse(TrimWhitespace(line), statements);
+            for (const std::string_view& statement : statements) {
+                Tokenize(TrimWhitespace(statement), tokens);
+                tokenCount += tokens.size();
+            }
+        }
+        const double seconds = duration<double>(high_resolution_clock::now() - start).count();
+        if (run == 0 || seconds < best)
+            best = seconds;
+    }
+
+    std::cout << "lines:       " << lines.size() << "\n"
+              << "bytes:       " << script.size() << "\n"
+              << "tokens:      " << tokenCount << "\n"
+              << "best of " << runs << ":   " << best * 1000.0 << " ms\n"
+              << "tokens/sec:  " << (size_t)(tokenCount / best) << "\n"
+              << "MB/sec:      " << script.size() / best / (1 << 20) << std::endl;
+    return 0;
+}
@@ -0,0 +1,160 @@
+// Microbenchmarks of the building blocks the front end and the engines run per character, per statement or per instruction:
+// the lexer functions, the conversions, Var copies and the separator lookup. Each runs over synthetic inputs of increasing size
+// and reports the time and the heap allocations of one call.
+// Build: cmake --build build --target primitive_bench, or g++ -std=c++20 -O2 -I LSInterpreter -o primitive_bench bench/PrimitiveBench.cpp
+// Usage: primitive_bench [filter] | Only runs the benchmarks whose name contains filter
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Runtime.h"
+
+using std::chrono::high_resolution_clock; using std::chrono::duration;
+
+//Every heap allocation of the process is counted, so a benchmark reports how many one call makes
+static size_t allocationCount = 0;
+
+void* operator new(size_t size) {
+    allocationCount++;
+    if (void* memory = std::malloc(size == 0 ? 1 : size))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+//Keeps the compiler from dropping a result that is never used
+template<typename T>
+void Keep(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static const void* volatile sink; sink = &value;
+#endif
+}
+
+const size_t sizes[] = { 8, 64, 512, 4096 };
+string filter;
+
+//Times a call, repeated until a run takes at least 20 ms, and prints the best of 3 runs per call
+void Measure(const string& name, const size_t& size, const std::function<void()>& call) {
+    if (!filter.empty() && name.find(filter) == string::npos)
+        return;
+
+    size_t repeats = 1;
+    while (true) {
+        const auto start = high_resolution_clock::now();
+        for (size_t i = 0; i < repeats; i++)
+            call();
+        if (duration<double>(high_resolution_clock::now() - start).count() >= 0.02 || repeats >= (1u << 30))
+            break;
+        repeats *= 2;
+    }
+
+    double best = 0.0; size_t allocations = 0;
+    for (int run = 0; run < 3; run++) {
+        const size_t allocationsBefore = allocationCount;
+        const auto start = high_resolution_clock::now();
+        for (size_t i = 0; i < repeats; i++)
+            call();
+        const double seconds = duration<double>(high_resolution_clock::now() - start).count();
+        allocations = allocationCount - allocationsBefore;
+        if (run == 0 || seconds < best)
+            best = seconds;
+    }
+
+    std::printf("%-30s %8zu %14.2f %14.2f\n", name.c_str(), size, best * 1e9 / repeats, (double)allocations / repeats);
+}
+
+//Returns: Text of about size characters made by repeating a piece
+string Repeat(const string& piece, const size_t& size) {
+    string text;
+    while (text.size() < size)
+        text += piece;
+    return text;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1)
+        filter = argv[1];
+    std::printf("%-30s %8s %14s %14s\n", "benchmark", "size", "ns/op", "allocs/op");
+
+    for (const size_t& size : sizes) {
+        const string padded = " \t " + Repeat("x", size) + " \r\n";
+        Measure("TrimWhitespace(view)", size, [&] { Keep(TrimWhitespace(std::string_view(padded))); });
+        Measure("TrimWhitespace(string)", size, [&] { Keep(TrimWhitespace(padded)); });
+    }
+
+    for (const size_t& size : sizes) {
+        const string line = Repeat("total += 1; print: \"a;b\"; ", size) + "# comment; not a statement";
+        vector<std::string_view> statements;
+        Measure("Parse", size, [&] { Parse(line, statements); Keep(statements); });
+    }
+
+    for (const size_t& size : sizes) {
+        const string statement = "print: " + Repeat("value_1, ", size) + "\"text, with separators\"";
+        Tokens tokens;
+        Measure("Tokenize", size, [&] { Tokenize(statement, tokens); Keep(tokens); });
+    }
+
+    for (const size_t& size : sizes) {
+        const string text = Repeat("var x = 1; ", size);
+        Measure("SplitString", size, [&] { Keep(SplitString(text, ';')); });
+    }
+
+    for (const size_t& size : sizes) {
+        const string integer = Repeat("1234567890", size), decimal = "-" + Repeat("12345", size / 2) + "." + Repeat("5", size / 2);
+        const string quoted = "\"" + Repeat("a", size) + "\"", word = Repeat("name_", size);
+        Measure("GetDataType(int)", size, [&] { Keep(GetDataType(integer)); });
+        Measure("GetDataType(double)", size, [&] { Keep(GetDataType(decimal)); });
+        Measure("GetDataType(string)", size, [&] { Keep(GetDataType(quoted)); });
+        Measure("GetDataType(identifier)", size, [&] { Keep(GetDataType(word)); });
+        Measure("FormatStringA", size, [&] { Keep(FormatStringA(quoted)); });
+    }
+
+    //Numbers only grow up to the digits an int holds
+    for (const string& number : { string("7"), string("-4096"), string("123456789") }) {
+        Measure("fast_stoi", number.size(), [&] { Keep(fast_stoi(number)); });
+        const string decimal = number + ".25";
+        Measure("fast_stod", decimal.size(), [&] { Keep(fast_stod(decimal)); });
+    }
+
+    Measure("Var copy(int)", 1, [] { Var var1(42); Var var2(var1); Keep(var2); });
+    Measure("Var assign(int)", 1, [] { Var var1(42), var2(1.5); var2 = var1; Keep(var2); });
+    for (const size_t& size : sizes) {
+        const string text = Repeat("s", size); const Var shared(text);
+        Measure("Var copy(string)", size, [&] { Var copy(shared); Keep(copy); });
+        Var target(string("t"));
+        Measure("Var assign(string)", size, [&] { target = shared; Keep(target); });
+        Var owned(string("o"));
+        Measure("Var SetData(string)", size, [&] { owned.SetData(text); Keep(owned); });
+        Measure("Var(string)", size, [&] { Var created(text); Keep(created); });
+    }
+
+    //Every pair of characters the lexer looks up, from the separators and the characters around them
+    std::mt19937 random(1);
+    const string alphabet = "=<>!+-*/%&|,:;(){}[]#\" \tabc019._";
+    for (const size_t& size : sizes) {
+        string text(size + 1, ' ');
+        for (char& c : text)
+            c = alphabet[random() % alphabet.size()];
+        Measure("ClassifySeparator(pairs)", size, [&] {
+            int sum = 0;
+            for (size_t i = 0; i < size; i++)
+                sum += ClassifySeparator(text[i], text[i + 1]) + ClassifySeparator(text[i]);
+            Keep(sum);
+        });
+    }
+    return 0;
+}
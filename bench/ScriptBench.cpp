@@ -0,0 +1,220 @@
+// End to end benchmark of the interpreter: runs every script in examples/ and a set of scaled workloads, each several times,
+// and writes the median wall time, instructions per second and peak RSS of every script as JSON.
+// Build: cmake -S . -B build && cmake --build build --target ls_bench
+// Usage: ls_bench [--interpreter path] [--stats-interpreter path] [--examples dir] [--runs N] [--scale N] [--out file.json]
+// The interpreter defaults to the ls target of the same build. Instructions are counted by the build made with LS_STATS,
+// so an older interpreter can be timed against the counts of this tree. Scripts run from a copy in ls_bench_work/,
+// so the .lsc caches stay out of the source tree. The first run of every script warms up the cache and is not timed.
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::string; using std::vector;
+namespace fs = std::filesystem;
+
+#ifndef LS_BENCH_INTERPRETER
+#define LS_BENCH_INTERPRETER "ls"
+#endif
+#ifndef LS_BENCH_STATS_INTERPRETER
+#define LS_BENCH_STATS_INTERPRETER ""
+#endif
+#ifndef LS_BENCH_EXAMPLES
+#define LS_BENCH_EXAMPLES "examples"
+#endif
+
+//A workload scaled by the --scale factor. COUNT in its source is replaced by its iteration count times the factor
+struct Workload {
+    string name; long long count; string source;
+};
+
+//Each workload runs for about 100 ms at scale 1 and stresses one part of the interpreter
+const vector<Workload> workloads = {
+    { "loop_heavy", 2000,
+        "var total = 0; var inner = 0;\n"
+        "for i = 0, i < COUNT, i++:\n"
+        "\tfor j = 0, j < 1000, j++:\n"
+        "\t\tinner = i; inner *= j; inner %= 7; total += inner;\n"
+        "\tend;\n"
+        "end;\n"
+        "printl: total;\n" },
+    { "call_heavy", 2000000,
+        "var result = 0;\n"
+        "call: main; exit: 0;\n"
+        "func Add(a, b):\n"
+        "\ta += b;\n"
+        "\treturn: a;\n"
+        "end;\n"
+        "func main():\n"
+        "\tfor i = 0, i < COUNT, i++:\n"
+        "\t\tAdd(i, 3) >> result;\n"
+        "\tend;\n"
+        "\tprintl: result;\n"
+        "end;\n" },
+    { "string_heavy", 20000,
+        "var text = \"\"; var count = 0;\n"
+        "for i = 0, i < COUNT, i++:\n"
+        "\ttext = \"\";\n"
+        "\tfor j = 0, j < 50, j++:\n"
+        "\t\ttext += \"ab\";\n"
+        "\tend;\n"
+        "\tcount++;\n"
+        "end;\n"
+        "printl: text; printl: count;\n" },
+    { "print_heavy", 600000,
+        "var half = 0.0;\n"
+        "for i = 0, i < COUNT, i++:\n"
+        "\tprint: i; print: \" \"; half = 0.5; half *= i; printl: half;\n"
+        "end;\n" },
+};
+
+//Result of running a script once
+struct Run {
+    double ms; long peakRssKb; int exitCode;
+};
+
+//Runs the interpreter on a script with stdin from /dev/null and stdout to a file. Returns: Its wall time, peak RSS and exit code
+Run RunScript(const string& interpreter, const vector<string>& options, const string& script, const string& outputPath) {
+    vector<string> args = { interpreter };
+    args.insert(args.end(), options.begin(), options.end());
+    args.push_back(script);
+    vector<char*> argv;
+    for (string& arg : args)
+        argv.push_back(arg.data());
+    argv.push_back(nullptr);
+
+    const auto start = std::chrono::steady_clock::now();
+    const pid_t child = fork();
+    if (child == 0) {
+        const int input = open("/dev/null", O_RDONLY);
+        const int output = open(outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        dup2(input, STDIN_FILENO); dup2(output, STDOUT_FILENO); dup2(output, STDERR_FILENO);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+
+    int status = 0; rusage usage = {};
+    wait4(child, &status, 0, &usage);
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    //ru_maxrss is in kilobytes on Linux and in bytes on macOS
+#ifdef __APPLE__
+    const long peakRssKb = usage.ru_maxrss / 1024;
+#else
+    const long peakRssKb = usage.ru_maxrss;
+#endif
+    return { ms, peakRssKb, WIFEXITED(status) ? (int)(signed char)WEXITSTATUS(status) : -1 };
+}
+
+//Returns: The number of instructions the stats build dispatches for a script, or 0 if it cannot count them
+unsigned long long CountInstructions(const string& statsInterpreter, const string& script, const string& outputPath) {
+    if (statsInterpreter.empty() || !fs::exists(statsInterpreter))
+        return 0;
+    RunScript(statsInterpreter, { "--stats=json" }, script, outputPath);
+
+    std::ifstream file(outputPath);
+    const string output((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const string key = "\"instructions\": ";
+    const size_t at = output.rfind(key);
+    return at == string::npos ? 0 : std::strtoull(output.c_str() + at + key.size(), nullptr, 10);
+}
+
+string EscapeJson(const string& text) {
+    string escaped;
+    for (const char& c : text) {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+int main(int argc, char* argv[]) {
+    string interpreter = LS_BENCH_INTERPRETER, statsInterpreter = LS_BENCH_STATS_INTERPRETER, examples = LS_BENCH_EXAMPLES, outPath;
+    int runs = 5, scale = 1;
+    for (int i = 1; i < argc; i++) {
+        const string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Option " << arg << " expects a value" << std::endl; return 1;
+        }
+        if (arg == "--interpreter") interpreter = argv[++i];
+        else if (arg == "--stats-interpreter") statsInterpreter = argv[++i];
+        else if (arg == "--examples") examples = argv[++i];
+        else if (arg == "--runs") runs = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--scale") scale = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--out") outPath = argv[++i];
+        else {
+            std::cerr << "Unknown option '" << arg << "'" << std::endl; return 1;
+        }
+    }
+    interpreter = fs::absolute(interpreter).string();
+    if (!statsInterpreter.empty())
+        statsInterpreter = fs::absolute(statsInterpreter).string();
+
+    //Copy the examples and write the workloads into the work directory
+    const fs::path work = fs::absolute("ls_bench_work");
+    fs::create_directories(work);
+    vector<string> names;
+    if (fs::is_directory(examples)) {
+        vector<fs::path> scripts;
+        for (const fs::directory_entry& entry : fs::directory_iterator(examples))
+            if (entry.path().extension() == ".ls")
+                scripts.push_back(entry.path());
+        std::sort(scripts.begin(), scripts.end());
+        for (const fs::path& script : scripts) {
+            fs::copy_file(script, work / script.filename(), fs::copy_options::overwrite_existing);
+            names.push_back(script.stem().string());
+        }
+    }
+    for (const Workload& workload : workloads) {
+        string source = workload.source;
+        source.replace(source.find("COUNT"), 5, std::to_string(workload.count * scale));
+        std::ofstream(work / (workload.name + ".ls")) << source;
+        names.push_back(workload.name);
+    }
+
+    std::ostringstream json;
+    json << "{\"interpreter\": \"" << EscapeJson(interpreter) << "\", \"runs\": " << runs << ", \"scale\": " << scale << ", \"scripts\": [";
+    std::cerr << "script                 median ms   instructions/s   peak RSS KB\n";
+    for (size_t s = 0; s < names.size(); s++) {
+        const string script = (work / (names[s] + ".ls")).string(), outputPath = (work / (names[s] + ".out")).string();
+        fs::remove(script + "c");
+
+        RunScript(interpreter, {}, script, outputPath);
+        vector<double> times; long peakRssKb = 0; int exitCode = 0;
+        for (int run = 0; run < runs; run++) {
+            const Run result = RunScript(interpreter, {}, script, outputPath);
+            times.push_back(result.ms); peakRssKb = std::max(peakRssKb, result.peakRssKb); exitCode = result.exitCode;
+        }
+        std::sort(times.begin(), times.end());
+        const double median = times.size() % 2 == 1 ? times[times.size() / 2] : (times[times.size() / 2 - 1] + times[times.size() / 2]) / 2.0;
+        const unsigned long long instructions = CountInstructions(statsInterpreter, script, outputPath + ".stats");
+        const double perSecond = median > 0.0 ? instructions / (median / 1000.0) : 0.0;
+
+        json << (s == 0 ? "" : ", ") << "{\"script\": \"" << EscapeJson(names[s]) << "\", \"median_ms\": " << median
+             << ", \"min_ms\": " << times.front() << ", \"max_ms\": " << times.back() << ", \"instructions\": " << instructions
+             << ", \"instructions_per_second\": " << (unsigned long long)perSecond << ", \"peak_rss_kb\": " << peakRssKb
+             << ", \"exit_code\": " << exitCode << "}";
+
+        char line[128];
+        std::snprintf(line, sizeof(line), "%-22s %10.2f %16.0f %13ld%s\n", names[s].c_str(), median, perSecond, peakRssKb,
+            exitCode == 0 ? "" : "  (failed)");
+        std::cerr << line;
+    }
+    json << "]}\n";
+
+    if (outPath.empty())
+        std::cout << json.str();
+    else
+        std::ofstream(outPath) << json.str();
+    return 0;
+}